@@ -0,0 +1,36 @@
+﻿#ifndef ZYX_RTSPSERVER_BASE64_H
+#define ZYX_RTSPSERVER_BASE64_H
+#include <string>
+#include <stdint.h>
+
+// 标准base64编码（带=填充），用于SDP中的sprop-parameter-sets等
+inline std::string base64Encode(const uint8_t* data, int size)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((size + 2) / 3 * 4);
+
+    int i = 0;
+    for (; i + 2 < size; i += 3) {
+        uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        out += table[(v >> 18) & 0x3F];
+        out += table[(v >> 12) & 0x3F];
+        out += table[(v >> 6) & 0x3F];
+        out += table[v & 0x3F];
+    }
+
+    if (i < size) {
+        uint32_t v = data[i] << 16;
+        if (i + 1 < size)
+            v |= data[i + 1] << 8;
+
+        out += table[(v >> 18) & 0x3F];
+        out += table[(v >> 12) & 0x3F];
+        out += (i + 1 < size) ? table[(v >> 6) & 0x3F] : '=';
+        out += '=';
+    }
+
+    return out;
+}
+
+#endif //ZYX_RTSPSERVER_BASE64_H
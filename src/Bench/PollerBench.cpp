@@ -0,0 +1,181 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#ifndef WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#endif // !WIN32
+#include "../Scheduler/SelectPoller.h"
+#include "../Scheduler/PollPoller.h"
+#include "../Scheduler/EPollPoller.h"
+
+/*
+    SelectPoller/PollPoller/EPollPoller的handleEvent耗时对比。
+    每种规模注册N个管道的读端，每轮向其中ACTIVE_NUM个随机管道各写1字节，再调用一次handleEvent，
+    读回调把该字节读走。结果是每次handleEvent（包含分发）的平均耗时。
+    管道的写端复制到较大的描述符上，使读端尽量小；读端超过FD_SETSIZE时select无法使用，跳过。
+    用法：PollerBench [每种规模的轮数，默认2000]
+*/
+
+#define ACTIVE_NUM 10
+#define WRITE_FD_BASE 8192
+
+struct Pipe
+{
+    int mReadFd;
+    int mWriteFd;
+    int* mHandled;
+};
+
+static void readCallback(void* arg)
+{
+    Pipe* p = (Pipe*)arg;
+    char c;
+    if (read(p->mReadFd, &c, 1) == 1)
+        ++*p->mHandled;
+}
+
+static bool raiseFdLimit(int need)
+{
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0)
+        return false;
+    if (rl.rlim_cur >= (rlim_t)need)
+        return true;
+    if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < (rlim_t)need)
+        return false;
+    rl.rlim_cur = need;
+    return setrlimit(RLIMIT_NOFILE, &rl) == 0;
+}
+
+static bool openPipes(std::vector<Pipe>& pipes, int num, int* handled)
+{
+    pipes.clear();
+    for (int i = 0; i < num; ++i)
+    {
+        int fds[2];
+        if (pipe(fds) != 0)
+            return false;
+
+        // 写端移到WRITE_FD_BASE之后，读端就是从3开始的连续描述符
+        int writeFd = fcntl(fds[1], F_DUPFD, WRITE_FD_BASE);
+        close(fds[1]);
+        if (writeFd < 0) {
+            close(fds[0]);
+            return false;
+        }
+
+        Pipe p = { fds[0], writeFd, handled };
+        pipes.push_back(p);
+    }
+    return true;
+}
+
+static void closePipes(std::vector<Pipe>& pipes)
+{
+    for (size_t i = 0; i < pipes.size(); ++i) {
+        close(pipes[i].mReadFd);
+        close(pipes[i].mWriteFd);
+    }
+    pipes.clear();
+}
+
+// 返回每次handleEvent的平均耗时（微秒），失败返回负数
+static double run(Poller* poller, int fdNum, int rounds)
+{
+    int handled = 0;
+    std::vector<Pipe> pipes;
+    pipes.reserve(fdNum);
+    if (!openPipes(pipes, fdNum, &handled)) {
+        closePipes(pipes);
+        return -1;
+    }
+
+    std::vector<IOEvent*> events;
+    for (int i = 0; i < fdNum; ++i)
+    {
+        IOEvent* event = IOEvent::createNew(pipes[i].mReadFd, &pipes[i]);
+        event->setReadCallback(readCallback);
+        event->enableReadHandling();
+        poller->addIOEvent(event);
+        events.push_back(event);
+    }
+
+    srand(12345);
+    double elapsed = 0;
+    for (int r = 0; r < rounds; ++r)
+    {
+        for (int k = 0; k < ACTIVE_NUM; ++k) {
+            if (write(pipes[rand() % fdNum].mWriteFd, "x", 1) != 1)
+                break;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        poller->handleEvent();
+        elapsed += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // 同一管道可能被写了多次，把剩余的数据读完再核对总数
+    while (handled < rounds * ACTIVE_NUM)
+        poller->handleEvent();
+
+    for (int i = 0; i < fdNum; ++i) {
+        poller->removeIOEvent(events[i]);
+        delete events[i];
+    }
+    closePipes(pipes);
+    return elapsed / rounds;
+}
+
+int main(int argc, char* argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+    const int fdNums[] = { 100, 1000, 5000 };
+    std::vector<std::string> results;
+
+    if (!raiseFdLimit(WRITE_FD_BASE + 5000 + 64)) {
+        printf("cannot raise RLIMIT_NOFILE to %d\n", WRITE_FD_BASE + 5000 + 64);
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(fdNums) / sizeof(fdNums[0]); ++i)
+    {
+        int fdNum = fdNums[i];
+        const char* names[] = { "select", "poll", "epoll" };
+        for (int type = 0; type < 3; ++type)
+        {
+            char line[128];
+            // 读端从3开始分配，最大的读端约为fdNum + 3
+            if (type == 0 && fdNum + 3 >= FD_SETSIZE) {
+                snprintf(line, sizeof(line), "fds=%-5d %-6s skipped, fd >= FD_SETSIZE(%d)", fdNum, names[type], FD_SETSIZE);
+                results.push_back(line);
+                continue;
+            }
+
+            Poller* poller = NULL;
+            if (type == 0)
+                poller = SelectPoller::createNew();
+            else if (type == 1)
+                poller = PollPoller::createNew();
+            else
+                poller = EPollPoller::createNew();
+
+            double us = run(poller, fdNum, rounds);
+            delete poller;
+
+            if (us < 0)
+                snprintf(line, sizeof(line), "fds=%-5d %-6s failed to open pipes", fdNum, names[type]);
+            else
+                snprintf(line, sizeof(line), "fds=%-5d %-6s %8.2f us/handleEvent", fdNum, names[type], us);
+            results.push_back(line);
+        }
+    }
+
+    printf("\nactive fds per round=%d,rounds=%d\n", ACTIVE_NUM, rounds);
+    for (size_t i = 0; i < results.size(); ++i)
+        printf("%s\n", results[i].c_str());
+    return 0;
+}
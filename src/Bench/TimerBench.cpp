@@ -0,0 +1,137 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "../Scheduler/EventScheduler.h"
+#include "../Scheduler/Event.h"
+#include "../Scheduler/Timer.h"
+
+/*
+    时间轮定时器的微基准测试，默认10万个定时器：
+    1. 添加：超时时间随机分布在10秒内（覆盖时间轮的各层），每次添加的平均耗时
+    2. 删除：逐个删除上一步添加的定时器，每次删除的平均耗时
+    3. 到期：超时时间随机分布在1秒内，运行loop直到全部执行，统计loop线程消耗的CPU时间
+    4. 周期：1万个每10ms执行一次的定时器运行1秒，统计每次执行的平均CPU时间
+    用法：TimerBench [定时器个数，默认100000]
+*/
+
+static EventScheduler* gScheduler = NULL;
+static int gFired = 0;
+static int gTarget = 0;
+
+static void timeoutCallback(void* arg)
+{
+    if (++gFired == gTarget)
+        gScheduler->quit();
+}
+
+static void quitCallback(void* arg)
+{
+    gScheduler->quit();
+}
+
+static double threadCpuNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void benchAddRemove(int num)
+{
+    EventScheduler* scheduler = EventScheduler::createNew(EventScheduler::POLLER_EPOLL);
+    TimerEvent* event = TimerEvent::createNew(NULL);
+    event->setTimeoutCallback(timeoutCallback);
+
+    std::vector<Timer::TimerId> ids(num);
+    Timer::TimestampNs now = Timer::getCurTimeNs();
+    srand(12345);
+
+    double start = threadCpuNs();
+    for (int i = 0; i < num; ++i)
+        ids[i] = scheduler->addTimedEventRunAtNs(event, now + 1000000 + (Timer::TimestampNs)(rand() % 10000) * 1000000);
+    double addNs = threadCpuNs() - start;
+
+    start = threadCpuNs();
+    int removed = 0;
+    for (int i = 0; i < num; ++i)
+        removed += scheduler->removeTimedEvent(ids[i]) ? 1 : 0;
+    double removeNs = threadCpuNs() - start;
+
+    printf("add:    %d timers,%.1f ns/timer\n", num, addNs / num);
+    printf("remove: %d timers,%.1f ns/timer%s\n", num, removeNs / num, removed == num ? "" : " (some timers not found)");
+
+    delete scheduler;
+    delete event;
+}
+
+static void benchExpire(int num)
+{
+    gScheduler = EventScheduler::createNew(EventScheduler::POLLER_EPOLL);
+    TimerEvent* event = TimerEvent::createNew(NULL);
+    event->setTimeoutCallback(timeoutCallback);
+    TimerEvent* quitEvent = TimerEvent::createNew(NULL);
+    quitEvent->setTimeoutCallback(quitCallback);
+
+    gFired = 0;
+    gTarget = num;
+    Timer::TimestampNs now = Timer::getCurTimeNs();
+    srand(12345);
+    for (int i = 0; i < num; ++i)
+        gScheduler->addTimedEventRunAtNs(event, now + (Timer::TimestampNs)(rand() % 1000000) * 1000);
+    gScheduler->addTimedEventRunAfater(quitEvent, 5000);// 防止未全部到期时一直运行
+
+    double start = threadCpuNs();
+    Timer::TimestampNs wallStart = Timer::getCurTimeNs();
+    gScheduler->loop();
+    double cpuNs = threadCpuNs() - start;
+    double wallMs = (Timer::getCurTimeNs() - wallStart) / 1e6;
+
+    printf("expire: %d/%d timers fired in %.0f ms,loop cpu %.1f ms,%.1f ns/timer\n",
+           gFired, num, wallMs, cpuNs / 1e6, cpuNs / (gFired > 0 ? gFired : 1));
+
+    delete gScheduler;
+    gScheduler = NULL;
+    delete event;
+    delete quitEvent;
+}
+
+static void benchPeriodic(int num, int intervalMs, int durationMs)
+{
+    gScheduler = EventScheduler::createNew(EventScheduler::POLLER_EPOLL);
+    TimerEvent* event = TimerEvent::createNew(NULL);
+    event->setTimeoutCallback(timeoutCallback);
+    TimerEvent* quitEvent = TimerEvent::createNew(NULL);
+    quitEvent->setTimeoutCallback(quitCallback);
+
+    gFired = 0;
+    gTarget = -1;
+    for (int i = 0; i < num; ++i)
+        gScheduler->addTimedEventRunEvery(event, intervalMs);
+    gScheduler->addTimedEventRunAfater(quitEvent, durationMs);
+
+    double start = threadCpuNs();
+    gScheduler->loop();
+    double cpuNs = threadCpuNs() - start;
+
+    printf("every:  %d timers every %d ms for %d ms,%d runs (expected about %d),loop cpu %.1f ms,%.1f ns/run\n",
+           num, intervalMs, durationMs, gFired, num * (durationMs / intervalMs), cpuNs / 1e6,
+           cpuNs / (gFired > 0 ? gFired : 1));
+
+    delete gScheduler;
+    gScheduler = NULL;
+    delete event;
+    delete quitEvent;
+}
+
+int main(int argc, char* argv[])
+{
+    int num = argc > 1 ? atoi(argv[1]) : 100000;
+    if (num <= 0)
+        num = 100000;
+
+    benchAddRemove(num);
+    benchExpire(num);
+    benchPeriodic(10000, 10, 1000);
+    return 0;
+}
@@ -0,0 +1,135 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <memory>
+#include <vector>
+#ifndef WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif // !WIN32
+#include "../Live/Rtp.h"
+#include "../Live/RtpInstance.h"
+#include "../Scheduler/SocketsOps.h"
+
+/*
+    UDP发送的每核包速率对比：把一帧100KB的I帧（约75个RTP包）发送给多个UDP客户端。
+    sendto：原来的方式，每个客户端每个包一次sockets::sendto
+    sendmmsg：RtpInstance::send，每个客户端每帧一次sendmmsg
+    gso：RtpInstance::send并开启GSO，不支持时RtpInstance自动回退到sendmmsg
+    所有客户端发往本机的同一个UDP端口，接收端不读取，内核在接收缓冲区满后直接丢弃，不影响发送端。
+    结果按本线程消耗的CPU时间计算，即单核每秒能发送的包数。
+    用法：UdpSendBench [客户端数，默认100] [帧数，默认20]
+*/
+
+#define FRAME_SIZE (100 * 1024)
+#define RTP_PAYLOAD_SIZE 1400
+
+static double threadCpuSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static RtpPacketListPtr buildFrame()
+{
+    int packetNum = (FRAME_SIZE + RTP_PAYLOAD_SIZE - 1) / RTP_PAYLOAD_SIZE;
+    RtpPacketListPtr packetList = std::make_shared<RtpPacketList>(
+        packetNum * RtpPacketList::packetSpace(RTP_HEADER_SIZE + RTP_PAYLOAD_SIZE));
+
+    for (int left = FRAME_SIZE; left > 0; left -= RTP_PAYLOAD_SIZE)
+    {
+        int payload = left > RTP_PAYLOAD_SIZE ? RTP_PAYLOAD_SIZE : left;
+        RtpHeader* rtpHeader = packetList->addPacket(RTP_HEADER_SIZE + payload);
+        memset(rtpHeader, 0, RTP_HEADER_SIZE + payload);
+        rtpHeader->version = RTP_VESION;
+        rtpHeader->payloadType = RTP_PAYLOAD_TYPE_H264;
+    }
+    return packetList;
+}
+
+static void report(const char* name, long packets, long expected, double cpuSec)
+{
+    printf("%-8s packets=%ld/%ld,cpu %.3f s,%.0f packets/s/core\n",
+           name, packets, expected, cpuSec, cpuSec > 0 ? packets / cpuSec : 0.0);
+}
+
+int main(int argc, char* argv[])
+{
+    int clientNum = argc > 1 ? atoi(argv[1]) : 100;
+    int frameNum = argc > 2 ? atoi(argv[2]) : 20;
+    if (clientNum <= 0 || frameNum <= 0) {
+        printf("usage: UdpSendBench [clients] [frames]\n");
+        return 1;
+    }
+
+    // 接收端：绑定本机的随机端口
+    int recvFd = sockets::createUdpSock();
+    if (recvFd < 0 || !sockets::bind(recvFd, "127.0.0.1", 0)) {
+        printf("create receiver failed\n");
+        return 1;
+    }
+    struct sockaddr_in recvAddr;
+    socklen_t addrLen = sizeof(recvAddr);
+    getsockname(recvFd, (struct sockaddr*)&recvAddr, &addrLen);
+    uint16_t recvPort = ntohs(recvAddr.sin_port);
+
+    // 每个客户端一个发送描述符，由RtpInstance负责关闭
+    std::vector<int> fds;
+    std::vector<RtpInstance*> instances;
+    for (int i = 0; i < clientNum; ++i)
+    {
+        int fd = sockets::createUdpSock();
+        if (fd < 0) {
+            printf("create udp socket failed,clients=%d\n", i);
+            return 1;
+        }
+        fds.push_back(fd);
+        instances.push_back(RtpInstance::createNewOverUdp(fd, 0, "127.0.0.1", recvPort));
+    }
+
+    RtpPacketListPtr frame = buildFrame();
+    int packetNum = frame->packetNum();
+    long expected = (long)packetNum * clientNum * frameNum;
+    printf("clients=%d,frames=%d,packets per frame=%d\n", clientNum, frameNum, packetNum);
+
+    // 原来的逐包发送
+    {
+        long packets = 0;
+        double start = threadCpuSec();
+        for (int f = 0; f < frameNum; ++f) {
+            for (int c = 0; c < clientNum; ++c) {
+                for (int i = 0; i < packetNum; ++i) {
+                    const RtpPacketList::Packet& packet = frame->packet(i);
+                    if (sockets::sendto(fds[c], packet.mBuf, packet.mSize, (struct sockaddr*)&recvAddr) > 0)
+                        ++packets;
+                }
+            }
+        }
+        report("sendto", packets, expected, threadCpuSec() - start);
+    }
+
+    for (int gso = 0; gso < 2; ++gso)
+    {
+        long packets = 0;
+        for (int c = 0; c < clientNum; ++c)
+            instances[c]->setGso(gso != 0);
+
+        double start = threadCpuSec();
+        for (int f = 0; f < frameNum; ++f) {
+            for (int c = 0; c < clientNum; ++c) {
+                int ret = instances[c]->send(frame);
+                if (ret > 0)
+                    packets += ret;
+            }
+        }
+        report(gso ? "gso" : "sendmmsg", packets, expected, threadCpuSec() - start);
+    }
+
+    for (int i = 0; i < clientNum; ++i)
+        delete instances[i];
+    sockets::close(recvFd);
+    return 0;
+}
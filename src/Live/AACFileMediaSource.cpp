@@ -2,48 +2,124 @@
 #include "AACFileMediaSource.h"
 #include "../Base/Log.h"
 
-AACFileMeidaSource* AACFileMeidaSource::createNew(UsageEnvironment* env, const std::string& file)
+static const uint32_t AACSampleRate[16] =
 {
-    return new AACFileMeidaSource(env, file);
+    96000, 88200, 64000, 48000,
+    44100, 32000, 24000, 22050,
+    16000, 12000, 11025, 8000,
+    7350, 0, 0, 0 /*reserved */
+};
+
+AACFileMeidaSource* AACFileMeidaSource::createNew(UsageEnvironment* env, const std::string& file, int frameNum)
+{
+    return new AACFileMeidaSource(env, file, frameNum);
 }
 
-AACFileMeidaSource::AACFileMeidaSource(UsageEnvironment* env, const std::string& file) :
-    MediaSource(env){
+AACFileMeidaSource::AACFileMeidaSource(UsageEnvironment* env, const std::string& file, int frameNum) :
+    MediaSource(env, frameNum),
+    mSampleRateIndex(4),
+    mChannelConfig(2),
+    mAudioObjectType(2),
+    mNextFrame(0){
 
     mSourceName = file;
-    mFile = fopen(file.c_str(), "rb");
-
-    setFps(43);
+    memset(&mAdtsHeader, 0, sizeof(mAdtsHeader));
 
-    for(int i = 0; i < DEFAULT_FRAME_NUM; ++i){
-        mEnv->threadPool()->addTask(mTask);
+    mFile = MappedFile::createNew(file);
+    if (mFile) {
+        mFile->prefault();
+        buildIndex();
     }
+
+    // 每个AAC帧1024个采样，fps只作参考，发送节奏由Sink按采样率精确计算
+    setFps((getSampleRate() + 512) / 1024);
+
+    requestFrames();// 开始预读，填满帧环形队列
 }
 
 AACFileMeidaSource::~AACFileMeidaSource()
 {
-    fclose(mFile);
+    delete mFile;
 }
 
-void AACFileMeidaSource::handleTask()
+// 一次解析所有ADTS头，记录每个原始帧的位置，之后取帧不再读文件
+void AACFileMeidaSource::buildIndex()
 {
-    std::lock_guard <std::mutex> lck(mMtx);
+    const uint8_t* data = mFile->data();
+    size_t size = mFile->size();
+    size_t pos = 0;
+    struct AdtsHeader header;
+
+    while (pos + 7 <= size)
+    {
+        // 同步字不对时逐字节向后查找下一个ADTS头
+        if (data[pos] != 0xFF || (data[pos + 1] & 0xF0) != 0xF0) {
+            ++pos;
+            continue;
+        }
+
+        parseAdtsHeader(data + pos, &header);
+        int headerSize = header.protectionAbsent ? 7 : 9;// protection_absent为0时带2字节crc
+        // 帧长度不合法（损坏的帧或数据中恰好出现的同步字）时跳过该字节继续查找，直到文件末尾
+        if ((int)header.aacFrameLength <= headerSize || pos + header.aacFrameLength > size) {
+            ++pos;
+            continue;
+        }
+
+        if (mAdtsFrames.empty()) {
+            mAdtsHeader = header;
+            if (AACSampleRate[header.samplingFreqIndex] != 0)
+                mSampleRateIndex = header.samplingFreqIndex;
+            mChannelConfig = header.channelCfg;
+            mAudioObjectType = header.profile + 1;
+        }
 
-    if(mFrameInputQueue.empty())
-        return;
-    MediaFrame* frame = mFrameInputQueue.front();
+        FrameIndex index;
+        index.mOffset = pos + headerSize;
+        index.mSize = header.aacFrameLength - headerSize;
+        mAdtsFrames.push_back(index);
 
-    frame->mSize = getFrameFromAACFile(frame->temp, FRAME_MAX_SIZE);
-    if (frame->mSize < 0) {
-        return;
+        pos += header.aacFrameLength;
     }
-    frame->mBuf = frame->temp;
 
-    mFrameInputQueue.pop();
-    mFrameOutputQueue.push(frame);
+    if (mAdtsFrames.empty())
+        LOGE("Read %s error, no adts frame", mSourceName.c_str());
+    else
+        LOGI("%s frames=%d", mSourceName.c_str(), (int)mAdtsFrames.size());
+}
+
+uint32_t AACFileMeidaSource::getSampleRate() const
+{
+    return AACSampleRate[mSampleRateIndex];
 }
 
-bool AACFileMeidaSource::parseAdtsHeader(uint8_t* in, struct AdtsHeader* res)
+uint32_t AACFileMeidaSource::getChannels() const
+{
+    // channel_configuration为0时声道数在PCE中描述，按双声道处理；7表示7.1声道
+    if (mChannelConfig == 0)
+        return 2;
+    if (mChannelConfig == 7)
+        return 8;
+    return mChannelConfig;
+}
+
+bool AACFileMeidaSource::readFrame(MediaFrame* frame)
+{
+    if(mAdtsFrames.empty())
+        return false;
+
+    // 零拷贝：frame直接引用映射内存中的原始帧，映射只读，发送方不能修改
+    const FrameIndex& index = mAdtsFrames[mNextFrame];
+    frame->mBuf = (uint8_t*)mFile->data() + index.mOffset;
+    frame->mSize = index.mSize;
+
+    if (++mNextFrame == mAdtsFrames.size())
+        mNextFrame = 0;
+
+    return true;
+}
+
+bool AACFileMeidaSource::parseAdtsHeader(const uint8_t* in, struct AdtsHeader* res)
 {
     memset(res,0,sizeof(*res));
 
@@ -76,47 +152,3 @@ bool AACFileMeidaSource::parseAdtsHeader(uint8_t* in, struct AdtsHeader* res)
         return false;
     }
 }
-
-int AACFileMeidaSource::getFrameFromAACFile(uint8_t* buf, int size)
-{
-    if (!mFile) {
-        return -1;
-    }
-
-    uint8_t tmpBuf[7];
-    int ret;
-
-    // 从文件 mFile 中读取 7 个字节，每个字节的大小为 1 字节，总共读取 7 字节数据并存储在 tmpBuf 中
-    ret = fread(tmpBuf,1,7,mFile);
-    if(ret <= 0)
-    {
-        fseek(mFile,0,SEEK_SET);
-        ret = fread(tmpBuf,1,7,mFile);
-        if(ret <= 0)
-        {
-            return -1;
-        }
-    }
-
-    //  解析tmpBuf, 存储在mAdtsHeader
-    if(!parseAdtsHeader(tmpBuf, &mAdtsHeader))
-    {
-        return -1;
-    }
-
-    if(mAdtsHeader.aacFrameLength > size)
-        return -1;
-
-    // tmpBuf 中的 7 字节数据（即 ADTS 头）复制到目标缓冲区 buf 中
-    memcpy(buf, tmpBuf, 7);
-
-    // 从 mFile 中读取实际的音频帧数据，长度为 aacFrameLength - 7（减去已经复制的 ADTS 头长度），并将数据存储在 buf 中的第 8 字节位置开始
-    ret = fread(buf+7,1,mAdtsHeader.aacFrameLength-7,mFile);
-    if(ret < 0)
-    {
-        LOGE("read error");
-        return -1;
-    }
-
-    return mAdtsHeader.aacFrameLength;
-}
\ No newline at end of file
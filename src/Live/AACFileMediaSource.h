@@ -1,18 +1,31 @@
 ﻿#ifndef ZYX_RTSPSERVER_AACFILEMEDIASOURCE_H
 #define ZYX_RTSPSERVER_AACFILEMEDIASOURCE_H
 #include <string>
+#include <vector>
 #include "MediaSource.h"
+#include "MappedFile.h"
 
+/*
+    ADTS格式的AAC文件：映射文件后一次建立帧索引，每个MediaFrame引用映射内存中的一个AAC原始帧（不含ADTS头），
+    映射在MediaSource的生命周期内一直有效。
+*/
 class AACFileMeidaSource : public MediaSource
 {
 public:
-    static AACFileMeidaSource* createNew(UsageEnvironment* env, const std::string& file);
+    static AACFileMeidaSource* createNew(UsageEnvironment* env, const std::string& file, int frameNum = DEFAULT_FRAME_NUM);
 
-    AACFileMeidaSource(UsageEnvironment* env, const std::string& file);
+    AACFileMeidaSource(UsageEnvironment* env, const std::string& file, int frameNum);
     virtual ~AACFileMeidaSource();
 
+    // 以下参数取自第一帧的ADTS头，文件无效时为AAC-LC 44100Hz 双声道
+    uint32_t getSampleRate() const;
+    uint32_t getSampleRateIndex() const { return mSampleRateIndex; }
+    uint32_t getChannels() const;
+    uint32_t getChannelConfig() const { return mChannelConfig; }
+    uint32_t getAudioObjectType() const { return mAudioObjectType; }// ADTS的profile + 1，1为AAC Main，2为AAC LC
+
 protected:
-    virtual void handleTask();
+    virtual bool readFrame(MediaFrame* frame);
 
 private:
     struct AdtsHeader
@@ -42,12 +55,23 @@ private:
         unsigned int numberOfRawDataBlockInFrame; //2 bit
     };
 
-    bool parseAdtsHeader(uint8_t* in, struct AdtsHeader* res);
-    int getFrameFromAACFile(uint8_t* buf, int size);
+    struct FrameIndex
+    {
+        size_t mOffset;// 去掉ADTS头后的原始帧在文件中的偏移
+        int mSize;
+    };
+
+    bool parseAdtsHeader(const uint8_t* in, struct AdtsHeader* res);
+    void buildIndex();
 
 private:
-    FILE* mFile;
-    struct AdtsHeader mAdtsHeader;
+    MappedFile* mFile;
+    struct AdtsHeader mAdtsHeader;// 第一帧的ADTS头
+    uint32_t mSampleRateIndex;
+    uint32_t mChannelConfig;
+    uint32_t mAudioObjectType;
+    std::vector<FrameIndex> mAdtsFrames;
+    size_t mNextFrame;// 下一个送入输出队列的帧，到结尾后回到开头循环播放
 };
 
 #endif //ZYX_RTSPSERVER_AACFILEMEDIASOURCE_H
\ No newline at end of file
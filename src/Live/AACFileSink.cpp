@@ -4,20 +4,25 @@
 #include <string.h>
 #include "../Base/Log.h"
 
-AACFileSink* AACFileSink::createNew(UsageEnvironment* env, MediaSource* mediaSource)
+AACFileSink* AACFileSink::createNew(UsageEnvironment* env, AACFileMeidaSource* mediaSource, bool aggregate)
 {
-    return new AACFileSink(env, mediaSource, RTP_PAYLOAD_TYPE_AAC);
+    return new AACFileSink(env, mediaSource, RTP_PAYLOAD_TYPE_AAC, aggregate);
 }
 
-AACFileSink::AACFileSink(UsageEnvironment* env, MediaSource* mediaSource, int payloadType) :
+AACFileSink::AACFileSink(UsageEnvironment* env, AACFileMeidaSource* mediaSource, int payloadType, bool aggregate) :
         Sink(env, mediaSource, payloadType),
-        mSampleRate(44100),
-        mChannels(2),
-        mFps(mediaSource->getFps())
+        mSampleRate(mediaSource->getSampleRate()),
+        mSampleRateIndex(mediaSource->getSampleRateIndex()),
+        mChannels(mediaSource->getChannels()),
+        mChannelConfig(mediaSource->getChannelConfig()),
+        mAudioObjectType(mediaSource->getAudioObjectType()),
+        mMaxDelayMs(aggregate ? AAC_AGGREGATE_MAX_DELAY_MS : 0),
+        mPendingSize(0),
+        mPendingTimestamp(0)
 {
     LOGI("AACFileSink()");
     mMarker = 1;
-    runEvery(1000/mFps);
+    runEvery(1024, mSampleRate);// 每个AAC帧1024个采样，按采样时钟发送，不会累积误差
 }
 
 AACFileSink::~AACFileSink()
@@ -33,64 +38,91 @@ std::string AACFileSink::getMediaDescription(uint16_t port)
     return std::string(buf);
 }
 
-static uint32_t AACSampleRate[16] =
-{
-    97000, 88200, 64000, 48000,
-    44100, 32000, 24000, 22050,
-    16000, 12000, 11025, 8000,
-    7350, 0, 0, 0 /*reserved */
-};
-
 std::string AACFileSink::getAttribute()
 {
     char buf[500] = { 0 };
-    sprintf(buf, "a=rtpmap:97 mpeg4-generic/%u/%u\r\n", mSampleRate, mChannels);
-
-    uint8_t index = 0;
-    for (index = 0; index < 16; index++)
-    {
-        if (AACSampleRate[index] == mSampleRate)
-            break;
-    }
-    if (index == 16)
-        return "";
+    sprintf(buf, "a=rtpmap:%d mpeg4-generic/%u/%u\r\n", mPayloadType, mSampleRate, mChannels);
 
-    uint8_t profile = 1;
-    char configStr[10] = {0};
-    sprintf(configStr, "%02x%02x", (uint8_t)((profile+1) << 3)|(index >> 1),
-            (uint8_t)((index << 7)|(mChannels<< 3)));
+    /*
+    *   AudioSpecificConfig（ISO 14496-3），SDP中以十六进制表示：
+    *   audioObjectType(5 bit) samplingFrequencyIndex(4 bit) channelConfiguration(4 bit) 其余3 bit为0
+    * */
+    uint8_t config[2];
+    config[0] = (uint8_t)((mAudioObjectType << 3) | (mSampleRateIndex >> 1));
+    config[1] = (uint8_t)(((mSampleRateIndex & 0x01) << 7) | (mChannelConfig << 3));
 
     sprintf(buf+strlen(buf),
             "a=fmtp:%d profile-level-id=1;"
             "mode=AAC-hbr;"
             "sizelength=13;indexlength=3;indexdeltalength=3;"
-            "config=%04u",
+            "config=%02X%02X",
             mPayloadType,
-            atoi(configStr));
+            config[0], config[1]);
 
     return std::string(buf);
 }
 
 void AACFileSink::sendFrame(MediaFrame* frame)
 {
-    RtpHeader* rtpHeader = mRtpPacket.mRtpHeader;
-    int frameSize = frame->mSize-7; //去掉aac头部
+    // 每个AAC帧在包中另占2字节AU-header，超过MTU时先把已攒的帧发出去
+    int payloadSize = 2 + 2 * (int)mPendingFrames.size() + mPendingSize;
+    if (!mPendingFrames.empty() && payloadSize + 2 + frame->mSize > RTP_MAX_PKT_SIZE)
+        flushPendingFrames();
+
+    if (mPendingFrames.empty())
+        mPendingTimestamp = mTimestamp;
+
+    PendingFrame pending;
+    pending.mBuf = frame->mBuf;// frame归还后映射内存依然有效
+    pending.mSize = frame->mSize;
+    mPendingFrames.push_back(pending);
+    mPendingSize += frame->mSize;
+
+    // 时间戳的时钟频率即采样率，每个AAC帧正好1024个采样
+    mTimestamp += 1024;
+
+    // 再加一帧就会超过延时上限时立即发送，包中音频的时长不超过上限；不聚合时每帧都立即发送
+    if ((uint64_t)(mPendingFrames.size() + 1) * 1024 * 1000 > (uint64_t)mMaxDelayMs * mSampleRate)
+        flushPendingFrames();
+}
 
-    rtpHeader->payload[0] = 0x00;
-    rtpHeader->payload[1] = 0x10;
-    rtpHeader->payload[2] = (frameSize & 0x1FE0) >> 5; //高8位
-    rtpHeader->payload[3] = (frameSize & 0x1F) << 3; //低5位
+void AACFileSink::flushPendingFrames()
+{
+    int num = (int)mPendingFrames.size();
+    int payloadSize = 2 + 2 * num + mPendingSize;
+    RtpPacketListPtr packetList = std::make_shared<RtpPacketList>(
+        RtpPacketList::packetSpace(RTP_HEADER_SIZE + payloadSize));
+
+    // RTP时间戳为包中第一个AAC帧的时间戳
+    uint32_t timestamp = mTimestamp;
+    mTimestamp = mPendingTimestamp;
+    RtpHeader* rtpHeader = packetList->addPacket(RTP_HEADER_SIZE + payloadSize);
+    setRtpHeader(rtpHeader);
+    mTimestamp = timestamp;
+
+    /*
+    *   AU-headers-length(16 bit，单位为bit)  AU-header 1 ... AU-header n   AU 1 ... AU n
+    *   每个AU-header：AU-size(13 bit) + AU-Index/AU-Index-delta(3 bit，连续的帧均为0)
+    * */
+    uint8_t* payload = rtpHeader->payload;
+    payload[0] = ((num * 16) >> 8) & 0xFF;
+    payload[1] = (num * 16) & 0xFF;
+    for (int i = 0; i < num; ++i) {
+        int frameSize = mPendingFrames[i].mSize;
+        payload[2 + 2 * i] = (frameSize & 0x1FE0) >> 5; //高8位
+        payload[3 + 2 * i] = (frameSize & 0x1F) << 3; //低5位
+    }
 
-    /* 去掉aac的头部 */
-    memcpy(rtpHeader->payload+4, frame->mBuf+7, frameSize);
-    mRtpPacket.mSize = RTP_HEADER_SIZE + 4 + frameSize;
+    payload += 2 + 2 * num;
+    for (int i = 0; i < num; ++i) {
+        memcpy(payload, mPendingFrames[i].mBuf, mPendingFrames[i].mSize);
+        payload += mPendingFrames[i].mSize;
+    }
 
-    sendRtpPacket(&mRtpPacket);
+    packetList->setFrameType(true, true);// 每个AAC帧都可以独立解码
+    sendRtpPacketList(packetList);
 
     mSeq++;
-
-    /* (1000 / mFps) 表示一帧多少毫秒 */
-    mTimestamp += mSampleRate * (1000 / mFps) / 1000;
-
+    mPendingFrames.clear();
+    mPendingSize = 0;
 }
-
@@ -1,16 +1,20 @@
 ﻿#ifndef ZYX_RTSPSERVER_AACFILESINK_H
 #define ZYX_RTSPSERVER_AACFILESINK_H
 
+#include <vector>
 #include "../Scheduler/UsageEnvironment.h"
 #include "Sink.h"
-#include "MediaSource.h"
+#include "AACFileMediaSource.h"
+
+#define AAC_AGGREGATE_MAX_DELAY_MS 100 // 聚合时一个RTP包最多攒多长时间的音频，超过后立即发送
 
 class AACFileSink : public Sink
 {
 public:
-    static AACFileSink* createNew(UsageEnvironment* env, MediaSource* mediaSource);;
+    // aggregate为true时，多个AAC帧放在一个RTP包中（RFC 3640 AAC-hbr的多AU-header），直到MTU或延时上限
+    static AACFileSink* createNew(UsageEnvironment* env, AACFileMeidaSource* mediaSource, bool aggregate = false);
     
-    AACFileSink(UsageEnvironment* env, MediaSource* mediaSource, int payloadType);
+    AACFileSink(UsageEnvironment* env, AACFileMeidaSource* mediaSource, int payloadType, bool aggregate);
     virtual ~AACFileSink();
 
     virtual std::string getMediaDescription(uint16_t port);
@@ -20,10 +24,25 @@ protected:
     virtual void sendFrame(MediaFrame* frame);
 
 private:
-    RtpPacket mRtpPacket;
-    uint32_t mSampleRate;   // 采样频率
+    void flushPendingFrames();
+
+private:
+    // 待发送的AAC原始帧，直接引用MediaSource的映射内存，不拷贝
+    struct PendingFrame
+    {
+        const uint8_t* mBuf;
+        int mSize;
+    };
+
+    uint32_t mSampleRate;   // 采样频率，也是RTP时间戳的时钟频率
+    uint32_t mSampleRateIndex;
     uint32_t mChannels;         // 通道数
-    int mFps;
+    uint32_t mChannelConfig;
+    uint32_t mAudioObjectType;
+    int mMaxDelayMs;// 0表示每帧单独发送
+    std::vector<PendingFrame> mPendingFrames;
+    int mPendingSize;// 已攒的帧数据字节数
+    uint32_t mPendingTimestamp;// 第一个待发送帧的时间戳
 };
 
 #endif //ZYX_RTSPSERVER_AACFILESINK_H
\ No newline at end of file
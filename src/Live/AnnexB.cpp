@@ -0,0 +1,171 @@
+﻿#include "AnnexB.h"
+#include <string.h>
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ANNEXB_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// 查找[buf, end)中第一个 00 00 third 的位置
+typedef const uint8_t* (*FindPatternFunc)(const uint8_t* buf, const uint8_t* end, uint8_t third);
+
+static const uint8_t* findPatternScalar(const uint8_t* buf, const uint8_t* end, uint8_t third)
+{
+    // 第三个字节不是0也不是third时，下一个可能的起点在3个字节之后
+    const uint8_t* p = buf;
+    while (p + 3 <= end)
+    {
+        if (p[2] > 1 && p[2] != third)
+            p += 3;
+        else if (p[0] == 0 && p[1] == 0 && p[2] == third)
+            return p;
+        else
+            ++p;
+    }
+    return NULL;
+}
+
+#ifdef ANNEXB_X86_SIMD
+// 每次比较16个起点：p[i]==0 && p[i+1]==0 && p[i+2]==third
+__attribute__((target("sse2")))
+static const uint8_t* findPatternSse2(const uint8_t* buf, const uint8_t* end, uint8_t third)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i val = _mm_set1_epi8((char)third);
+    const uint8_t* p = buf;
+
+    while (p + 16 + 2 <= end)
+    {
+        __m128i z0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), zero);
+        __m128i z1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 1)), zero);
+        __m128i v2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 2)), val);
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(z0, z1), v2));
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    return findPatternScalar(p, end, third);
+}
+
+// 每次比较32个起点
+__attribute__((target("avx2")))
+static const uint8_t* findPatternAvx2(const uint8_t* buf, const uint8_t* end, uint8_t third)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i val = _mm256_set1_epi8((char)third);
+    const uint8_t* p = buf;
+
+    while (p + 32 + 2 <= end)
+    {
+        __m256i z0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), zero);
+        __m256i z1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 1)), zero);
+        __m256i v2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 2)), val);
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(z0, z1), v2));
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return findPatternSse2(p, end, third);
+}
+#endif // ANNEXB_X86_SIMD
+
+struct Scanner
+{
+    FindPatternFunc mFind;
+    const char* mName;
+};
+
+// 第一次使用时按CPU选择实现，局部静态变量的初始化是线程安全的
+static Scanner& scanner()
+{
+    static Scanner s = []() {
+        Scanner sc = { findPatternScalar, "scalar" };
+#ifdef ANNEXB_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            sc.mFind = findPatternAvx2;
+            sc.mName = "avx2";
+        }
+        else if (__builtin_cpu_supports("sse2")) {
+            sc.mFind = findPatternSse2;
+            sc.mName = "sse2";
+        }
+#endif // ANNEXB_X86_SIMD
+        return sc;
+    }();
+    return s;
+}
+
+namespace annexb
+{
+
+const uint8_t* findStartCode(const uint8_t* buf, const uint8_t* end)
+{
+    if (!buf || end - buf < 3)
+        return NULL;
+
+    const uint8_t* p = scanner().mFind(buf, end, 1);
+    if (!p)
+        return NULL;
+
+    // 00 00 00 01：前面的0属于4字节起始码
+    if (p > buf && p[-1] == 0)
+        return p - 1;
+    return p;
+}
+
+int removeEmulationPrevention(const uint8_t* src, int size, uint8_t* dst)
+{
+    const uint8_t* end = src + size;
+    const uint8_t* p = src;
+    int len = 0;
+
+    // 找到每个 00 00 03，把其前面的数据连同 00 00 整段拷贝，跳过03
+    while (true)
+    {
+        const uint8_t* q = scanner().mFind(p, end, 3);
+        if (!q)
+            break;
+
+        int n = (int)(q - p) + 2;
+        memmove(dst + len, p, n);
+        len += n;
+        p = q + 3;
+    }
+
+    memmove(dst + len, p, end - p);
+    len += (int)(end - p);
+    return len;
+}
+
+const char* scannerName()
+{
+    return scanner().mName;
+}
+
+bool useScanner(const char* name)
+{
+    Scanner& cur = scanner();// 先完成一次自动选择，其中调用了__builtin_cpu_init
+    Scanner sc = { NULL, NULL };
+    if (strcmp(name, "scalar") == 0) {
+        sc.mFind = findPatternScalar;
+        sc.mName = "scalar";
+    }
+#ifdef ANNEXB_X86_SIMD
+    else if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        sc.mFind = findPatternSse2;
+        sc.mName = "sse2";
+    }
+    else if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        sc.mFind = findPatternAvx2;
+        sc.mName = "avx2";
+    }
+#endif // ANNEXB_X86_SIMD
+
+    if (!sc.mFind)
+        return false;
+
+    cur = sc;
+    return true;
+}
+
+}
@@ -0,0 +1,25 @@
+﻿#ifndef ZYX_RTSPSERVER_ANNEXB_H
+#define ZYX_RTSPSERVER_ANNEXB_H
+#include <stdint.h>
+
+/*
+    Annex-B码流（H.264/H.265裸流）的起始码查找和防竞争字节处理。
+    x86下按CPU在运行时选择AVX2/SSE2实现，其他平台使用逐字节的实现，结果完全一致。
+*/
+namespace annexb
+{
+    // 返回[buf, end)中第一个起始码（00 00 01 或 00 00 00 01）的位置，没有则返回NULL
+    // 与逐字节依次判断3字节、4字节起始码的结果相同：00 00 00 01 返回第一个00的位置
+    const uint8_t* findStartCode(const uint8_t* buf, const uint8_t* end);
+
+    // 去掉nalu中的防竞争字节（00 00 03 中的03），得到RBSP，返回写入dst的字节数
+    // dst至少size字节，可以与src相同
+    int removeEmulationPrevention(const uint8_t* src, int size, uint8_t* dst);
+
+    const char* scannerName();// 当前使用的实现："avx2"、"sse2"或"scalar"
+
+    // 强制使用指定的实现，供测试和性能对比使用；CPU不支持时返回false，保持原实现不变
+    bool useScanner(const char* name);
+}
+
+#endif //ZYX_RTSPSERVER_ANNEXB_H
@@ -0,0 +1,71 @@
+﻿#ifndef ZYX_RTSPSERVER_BITREADER_H
+#define ZYX_RTSPSERVER_BITREADER_H
+#include <stdint.h>
+
+/*
+    按比特读取RBSP（已去掉防竞争字节），支持指数哥伦布编码，用于解析SPS等参数集。
+    读越界时返回0并设置错误标志，调用方在解析结束后检查error()。
+*/
+class BitReader
+{
+public:
+    BitReader(const uint8_t* buf, int size) :
+        mBuf(buf), mSize(size), mPos(0), mError(false) {
+    }
+
+    uint32_t readBit()
+    {
+        if (mPos >= mSize * 8) {
+            mError = true;
+            return 0;
+        }
+        uint32_t bit = (mBuf[mPos >> 3] >> (7 - (mPos & 7))) & 1;
+        ++mPos;
+        return bit;
+    }
+
+    uint32_t readBits(int n)// n不超过32
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < n; ++i)
+            v = (v << 1) | readBit();
+        return v;
+    }
+
+    void skipBits(int n)
+    {
+        mPos += n;
+        if (mPos > mSize * 8)
+            mError = true;
+    }
+
+    // ue(v)
+    uint32_t readUe()
+    {
+        int zeros = 0;
+        while (readBit() == 0) {
+            if (mError || ++zeros > 31) {
+                mError = true;
+                return 0;
+            }
+        }
+        return ((uint32_t)1 << zeros) - 1 + readBits(zeros);
+    }
+
+    // se(v)
+    int32_t readSe()
+    {
+        uint32_t v = readUe();
+        return (v & 1) ? (int32_t)((v + 1) / 2) : -(int32_t)(v / 2);
+    }
+
+    bool error() const { return mError; }
+
+private:
+    const uint8_t* mBuf;
+    int mSize;
+    int mPos;// 比特位置
+    bool mError;
+};
+
+#endif //ZYX_RTSPSERVER_BITREADER_H
@@ -1,161 +1,205 @@
 ﻿#include "H264FileMediaSource.h"
+#include "AnnexB.h"
 #include "../Base/Log.h"
-#include <fcntl.h>
 
-static inline int startCode3(uint8_t* buf);
-static inline int startCode4(uint8_t* buf);
-
-H264FileMediaSource* H264FileMediaSource::createNew(UsageEnvironment* env, const std::string& file)
+H264FileMediaSource* H264FileMediaSource::createNew(UsageEnvironment* env, const std::string& file, int frameNum)
 {
-    return new H264FileMediaSource(env, file);
+    return new H264FileMediaSource(env, file, frameNum);
     //    return New<H264FileMediaSource>::allocate(env, file);
 }
 
-H264FileMediaSource::H264FileMediaSource(UsageEnvironment* env, const std::string& file) :
-    MediaSource(env) {
+H264FileMediaSource::H264FileMediaSource(UsageEnvironment* env, const std::string& file, int frameNum) :
+    MediaSource(env, frameNum),
+    mNextAu(0),
+    mHasSpsInfo(false),
+    mFrameRateNum(25),
+    mFrameRateDen(1) {
 
     mSourceName = file;
 
-    mFile = fopen(file.c_str(), "rb");
+    mFile = MappedFile::createNew(file);
     if (mFile == nullptr) {
         LOGE("Failed to open file");
         // 处理错误，例如返回或抛出异常
     }
     else {
         LOGI("Succuss open H264File");
+        mFile->prefault();
+        buildIndex();
+        parseParameterSets();
     }
 
-    setFps(25);
+    // 按整数帧率四舍五入，精确的帧率通过getFrameRateNum()/getFrameRateDen()获取
+    setFps((mFrameRateNum + mFrameRateDen / 2) / mFrameRateDen);
 
-    for (int i = 0; i < DEFAULT_FRAME_NUM; ++i) {
-        mEnv->threadPool()->addTask(mTask);
-    }
+    requestFrames();// 开始预读，填满帧环形队列
 }
 
 H264FileMediaSource::~H264FileMediaSource()
 {
-    fclose(mFile);
+    delete mFile;
 }
 
-void H264FileMediaSource::handleTask()
+// 按H.264 7.4.1.2.3判断nalu是否开始一个新的访问单元，hasVcl表示当前访问单元中已有图像数据
+bool H264FileMediaSource::isNewAccessUnit(const uint8_t* nalu, int size, bool hasVcl)
 {
-    std::lock_guard <std::mutex> lck(mMtx);
+    if (!hasVcl)
+        return false;
 
-    if (mFrameInputQueue.empty())
-        return;
+    uint8_t type = nalu[0] & 0x1F;
+    switch (type)
+    {
+        case 1:
+        case 5:
+            // 新图像的第一个slice：first_mb_in_slice为0，其ue(v)编码的第一个比特为1
+            return size > 1 && (nalu[1] & 0x80);
+        case 6:// SEI
+        case 7:// SPS
+        case 8:// PPS
+        case 9:// AUD
+            return true;
+        default:
+            return type >= 14 && type <= 18;
+    }
+}
 
-    MediaFrame* frame = mFrameInputQueue.front();
-    int startCodeNum = 0;
+// 一次扫描整个文件，记录每个nalu的位置和类型并划分访问单元，之后取帧不再读文件和查找起始码
+void H264FileMediaSource::buildIndex()
+{
+    const uint8_t* data = mFile->data();
+    const uint8_t* end = data + mFile->size();
+    const uint8_t* cur = annexb::findStartCode(data, end);
+    bool hasVcl = false;
 
-    while (true)
+    while (cur)
     {
-        //  每次尝试读取到一个完整的 NALU 到frame->temp
-        frame->mSize = getFrameFromH264File(frame->temp, FRAME_MAX_SIZE);
-        if (frame->mSize < 0) {
-            return;
-        }
-        if (startCode3(frame->temp)){
-            startCodeNum = 3;
-        }else{
-            startCodeNum = 4;
-        }
+        int startCodeNum = (cur[2] == 1) ? 3 : 4;// findStartCode返回的位置一定是3或4字节起始码
+        const uint8_t* nalu = cur + startCodeNum;
+        const uint8_t* next = annexb::findStartCode(nalu, end);
+        const uint8_t* naluEnd = next ? next : end;
+        cur = next;
 
-        // 去掉起始码并调整缓冲区
-        frame->mBuf = frame->temp + startCodeNum;
-        frame->mSize -= startCodeNum;
+        if (naluEnd <= nalu)
+            continue;
 
-        // 获取NAL头的最后 5 位 
-        uint8_t naluType = frame->mBuf[0] & 0x1F;
-        //LOGI("startCodeNum=%d,naluType=%d,naluSize=%d", startCodeNum, naluType, frame->mSize);
+        NaluIndex index;
+        index.mOffset = nalu - data;
+        index.mSize = (int)(naluEnd - nalu);
+        index.mType = nalu[0] & 0x1F;
+        index.mIsIdr = index.mType == 5;
+
+        if (mAccessUnits.empty() || isNewAccessUnit(nalu, index.mSize, hasVcl)) {
+            AccessUnit au;
+            au.mFirstNalu = mNalus.size();
+            au.mNaluNum = 0;
+            au.mIsKey = false;
+            mAccessUnits.push_back(au);
+            hasVcl = false;
+        }
 
-        if (0x09 == naluType) {
-            // discard the type byte
-            // 表示分隔符 NAL 单元， 跳过该帧并继续读取下一帧
+        // 0x09表示分隔符 NAL 单元，只用于划分访问单元，不需要发送
+        if (index.mType == 0x09)
             continue;
-        }
 
-        // 如果 NAL 类型是 0x07（序列参数集，SPS）或 0x08（图像参数集，PPS）
-        // 则停止读取，但不会跳过帧。
-        // SPS 和 PPS 是 H.264 视频流中的重要数据，表示视频编码参数，需要保存下来。
-        else if (0x07 == naluType || 0x08 == naluType) {
-            //continue;
-            break;
-        }
+        AccessUnit& au = mAccessUnits.back();
+        au.mNaluNum++;
+        if (index.mIsIdr)
+            au.mIsKey = true;
+        if (index.mType >= 1 && index.mType <= 5)
+            hasVcl = true;
 
-        else {
-            break;
-        }
+        mNalus.push_back(index);
     }
 
-    mFrameInputQueue.pop();
-    mFrameOutputQueue.push(frame);
-}
+    // 去掉只有分隔符的访问单元
+    for (size_t i = 0; i < mAccessUnits.size();) {
+        if (mAccessUnits[i].mNaluNum == 0)
+            mAccessUnits.erase(mAccessUnits.begin() + i);
+        else
+            ++i;
+    }
 
-static inline int startCode3(uint8_t* buf)
-{
-    if (buf[0] == 0 && buf[1] == 0 && buf[2] == 1)
-        return 1;
+    if (mAccessUnits.empty())
+        LOGE("Read %s error, no startCode3 and no startCode4", mSourceName.c_str());
     else
-        return 0;
+        LOGI("%s nalus=%d,access units=%d,scanner=%s", mSourceName.c_str(), (int)mNalus.size(),
+             (int)mAccessUnits.size(), annexb::scannerName());
 }
 
-static inline int startCode4(uint8_t* buf)
+// 取第一组SPS/PPS，解析出profile、level、分辨率和帧率，解码器可以在收到第一个RTP包之前完成初始化
+void H264FileMediaSource::parseParameterSets()
 {
-    if (buf[0] == 0 && buf[1] == 0 && buf[2] == 0 && buf[3] == 1)
-        return 1;
-    else
-        return 0;
-}
+    for (size_t i = 0; i < mNalus.size() && (mSps.empty() || mPps.empty()); ++i)
+    {
+        const NaluIndex& index = mNalus[i];
+        const char* nalu = (const char*)mFile->data() + index.mOffset;
+        if (index.mType == 7 && mSps.empty())
+            mSps.assign(nalu, index.mSize);
+        else if (index.mType == 8 && mPps.empty())
+            mPps.assign(nalu, index.mSize);
+    }
 
-static uint8_t* findNextStartCode(uint8_t* buf, int len)
-{
-    int i;
+    if (mSps.empty()) {
+        LOGE("%s no sps", mSourceName.c_str());
+        return;
+    }
 
-    if (len < 3)
-        return NULL;
+    mHasSpsInfo = h264::parseSps((const uint8_t*)mSps.data(), (int)mSps.size(), &mSpsInfo);
+    if (!mHasSpsInfo) {
+        LOGE("%s parse sps error", mSourceName.c_str());
+        return;
+    }
 
-    for (i = 0; i < len - 3; ++i)
-    {
-        if (startCode3(buf) || startCode4(buf))
-            return buf;
+    if (mSpsInfo.mFrameRateNum > 0) {
+        mFrameRateNum = mSpsInfo.mFrameRateNum;
+        mFrameRateDen = mSpsInfo.mFrameRateDen;
+    }
 
-        ++buf;
+    LOGI("%s profile=%d,level=%d,%dx%d,fps=%u/%u", mSourceName.c_str(), mSpsInfo.mProfileIdc,
+         mSpsInfo.mLevelIdc, mSpsInfo.mWidth, mSpsInfo.mHeight, mFrameRateNum, mFrameRateDen);
+}
+
+bool H264FileMediaSource::readFrame(MediaFrame* frame)
+{
+    std::lock_guard <std::mutex> lck(mMtx);// 只与seek()竞争，Sink取帧不需要这把锁
+
+    if (mAccessUnits.empty())
+        return false;
+
+    // 零拷贝：frame直接引用映射内存中的nalu（不含起始码），映射只读，发送方不能修改
+    const AccessUnit& au = mAccessUnits[mNextAu];
+    frame->mNalus.clear();
+    for (int i = 0; i < au.mNaluNum; ++i) {
+        const NaluIndex& index = mNalus[au.mFirstNalu + i];
+        MediaFrame::Nalu nalu;
+        nalu.mBuf = (uint8_t*)mFile->data() + index.mOffset;
+        nalu.mSize = index.mSize;
+        frame->mNalus.push_back(nalu);
     }
+    frame->mBuf = frame->mNalus[0].mBuf;
+    frame->mSize = frame->mNalus[0].mSize;
 
-    if (startCode3(buf))
-        return buf;
+    if (++mNextAu == mAccessUnits.size())
+        mNextAu = 0;
 
-    return NULL;
+    return true;
 }
 
-// 从 H.264 文件中读取一帧数据
-int H264FileMediaSource::getFrameFromH264File(uint8_t* frame, int size)
+bool H264FileMediaSource::seek(int64_t ms)
 {
-    if (!mFile) {
-        return -1;
-    }
+    std::lock_guard <std::mutex> lck(mMtx);
 
-    int r, frameSize;
-    uint8_t* nextStartCode;
+    if (mAccessUnits.empty() || ms < 0)
+        return false;
 
-    r = fread(frame, 1, size, mFile);
-    // H.264 帧的起始码, 3 字节的起始码, 4 字节的起始码
-    if (!startCode3(frame) && !startCode4(frame)) {
-        fseek(mFile, 0, SEEK_SET);
-        LOGE("Read % s error, no startCode3 and no startCode4",mSourceName.c_str());
-        return -1;
-    }
+    // 每个访问单元一帧
+    size_t target = (size_t)(ms * mFrameRateNum / mFrameRateDen / 1000);
+    if (target >= mAccessUnits.size())
+        target = mAccessUnits.size() - 1;
 
-    //从 frame + 3 开始查找（跳过当前的起始码），r - 3 是要查找的字节数
-    nextStartCode = findNextStartCode(frame + 3, r - 3);
-    if (!nextStartCode) {
-        fseek(mFile, 0, SEEK_SET);
-        frameSize = r;
-        LOGE("Read %s error, no nextStartCode, r=%d", mSourceName.c_str(),r);
-    }else {
-        //起始码到下一个起始码之间的字节数
-        frameSize = (nextStartCode - frame);
-        fseek(mFile, frameSize - r, SEEK_CUR);
-    }
-    return frameSize;
-}
\ No newline at end of file
+    while (target > 0 && !mAccessUnits[target].mIsKey)
+        --target;
+
+    mNextAu = target;
+    return true;
+}
@@ -3,24 +3,67 @@
 
 
 #include <string>
+#include <vector>
 #include "MediaSource.h"
+#include "MappedFile.h"
+#include "H264Parser.h"
 
 class H264FileMediaSource : public MediaSource
 {
 public:
-    static H264FileMediaSource* createNew(UsageEnvironment* env, const std::string& file);
+    static H264FileMediaSource* createNew(UsageEnvironment* env, const std::string& file, int frameNum = DEFAULT_FRAME_NUM);
 
-    H264FileMediaSource(UsageEnvironment* env, const std::string& file);
+    H264FileMediaSource(UsageEnvironment* env, const std::string& file, int frameNum);
     virtual ~H264FileMediaSource();
 
+    // 跳到不晚于ms的最近一个关键帧（其访问单元包含SPS/PPS），已在输出队列中的帧仍会先发出
+    bool seek(int64_t ms);
+
+    // 打开时从码流中取得的第一组SPS/PPS（不含起始码），用于SDP，没有时为空
+    const std::string& getSps() const { return mSps; }
+    const std::string& getPps() const { return mPps; }
+    const h264::SpsInfo* getSpsInfo() const { return mHasSpsInfo ? &mSpsInfo : NULL; }
+    // 帧率 num/den：优先取SPS的VUI，没有时为默认的25帧
+    uint32_t getFrameRateNum() const { return mFrameRateNum; }
+    uint32_t getFrameRateDen() const { return mFrameRateDen; }
+
 protected:
-    virtual void handleTask();
+    virtual bool readFrame(MediaFrame* frame);
 
 private:
-    int getFrameFromH264File(uint8_t* frame, int size);
+    // 打开文件时建立一次的NALU索引，帧数据直接引用映射内存
+    struct NaluIndex
+    {
+        size_t mOffset;// 去掉起始码后nalu在文件中的偏移
+        int mSize;
+        uint8_t mType;
+        bool mIsIdr;
+    };
+
+    // 访问单元：一幅图像及其前面的SPS/PPS/SEI等，对应mNalus中连续的一段
+    struct AccessUnit
+    {
+        size_t mFirstNalu;
+        int mNaluNum;
+        bool mIsKey;// 包含IDR
+    };
+
+    void buildIndex();
+    void parseParameterSets();
+    static bool isNewAccessUnit(const uint8_t* nalu, int size, bool hasVcl);
 
 private:
-    FILE* mFile;
+    MappedFile* mFile;
+    std::vector<NaluIndex> mNalus;
+    std::vector<AccessUnit> mAccessUnits;
+    size_t mNextAu;// 下一个送入输出队列的访问单元，到结尾后回到开头循环播放
+
+    std::string mSps;
+    std::string mPps;
+    h264::SpsInfo mSpsInfo;
+    bool mHasSpsInfo;
+    uint32_t mFrameRateNum;
+    uint32_t mFrameRateDen;
 };
 
-#endif //ZYX_RTSPSERVER_H264FILEMEDIASOURCE_H
\ No newline at end of file
+#endif //ZYX_RTSPSERVER_H264FILEMEDIASOURCE_H
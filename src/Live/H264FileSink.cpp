@@ -1,24 +1,30 @@
 ﻿#include <stdio.h>
 #include <string.h>
 #include "H264FileSink.h"
+#include "../Base/Base64.h"
 #include "../Base/Log.h"
 
-H264FileSink* H264FileSink::createNew(UsageEnvironment* env, MediaSource* mediaSource)
+H264FileSink* H264FileSink::createNew(UsageEnvironment* env, H264FileMediaSource* mediaSource, bool stapA)
 {
     if (!mediaSource)
         return NULL;
 
-    return new H264FileSink(env, mediaSource);
+    return new H264FileSink(env, mediaSource, stapA);
 
 }
 
-H264FileSink::H264FileSink(UsageEnvironment* env, MediaSource* mediaSource) :
+H264FileSink::H264FileSink(UsageEnvironment* env, H264FileMediaSource* mediaSource, bool stapA) :
         Sink(env, mediaSource, RTP_PAYLOAD_TYPE_H264),
+        mH264Source(mediaSource),
         mClockRate(90000),
-        mFps(mediaSource->getFps())
+        mFrameRateNum(mediaSource->getFrameRateNum()),
+        mFrameRateDen(mediaSource->getFrameRateDen()),
+        mPictureCount(0),
+        mStapA(stapA)
 {
     LOGI("H264FileSink()");
-    runEvery(1000 / mFps);
+    setGopCacheEnabled(true);// 新的观看者从最近的IDR开始解码
+    runEvery(mFrameRateDen, mFrameRateNum);
 }
 
 H264FileSink::~H264FileSink()
@@ -36,87 +42,193 @@ std::string H264FileSink::getMediaDescription(uint16_t port)
 
 std::string H264FileSink::getAttribute()
 {
-    char buf[100];
+    char buf[1024];
     sprintf(buf, "a=rtpmap:%d H264/%d\r\n", mPayloadType, mClockRate);
-    sprintf(buf + strlen(buf), "a=framerate:%d", mFps);
+
+    // FU-A和STAP-A都属于非交错模式（packetization-mode=1）
+    sprintf(buf + strlen(buf), "a=fmtp:%d packetization-mode=1", mPayloadType);
+
+    // 带上参数集，播放器不必等待带内的SPS/PPS即可初始化解码器
+    const std::string& sps = mH264Source->getSps();
+    const std::string& pps = mH264Source->getPps();
+    if (sps.size() >= 4) {
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), ";profile-level-id=%02X%02X%02X",
+                 (uint8_t)sps[1], (uint8_t)sps[2], (uint8_t)sps[3]);
+
+        std::string sprop = base64Encode((const uint8_t*)sps.data(), (int)sps.size());
+        if (!pps.empty())
+            sprop += "," + base64Encode((const uint8_t*)pps.data(), (int)pps.size());
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), ";sprop-parameter-sets=%s", sprop.c_str());
+    }
+
+    const h264::SpsInfo* info = mH264Source->getSpsInfo();
+    if (info)
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "\r\na=framesize:%d %d-%d",
+                 mPayloadType, info->mWidth, info->mHeight);
+
+    if (mFrameRateNum % mFrameRateDen == 0)
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "\r\na=framerate:%u", mFrameRateNum / mFrameRateDen);
+    else
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "\r\na=framerate:%.2f",
+                 (double)mFrameRateNum / mFrameRateDen);
 
     return std::string(buf);
 }
 
+// 一个nalu封包后占用的空间：单包发送或FU-A分片
+static int naluPacketSpace(int naluSize)
+{
+    if (naluSize <= RTP_MAX_PKT_SIZE)
+        return RtpPacketList::packetSpace(RTP_HEADER_SIZE + naluSize);
+
+    int pktNum = (naluSize - 1 + RTP_MAX_PKT_SIZE - 1) / RTP_MAX_PKT_SIZE;
+    return pktNum * RtpPacketList::packetSpace(RTP_HEADER_SIZE + 2 + RTP_MAX_PKT_SIZE);
+}
+
 void H264FileSink::sendFrame(MediaFrame* frame)
 {
-    // 发送RTP数据包
+    // 一个访问单元（一幅图像）封包到一个只读的RTP包列表中，所有包使用同一个时间戳，帧数据只拷贝一次
+    int capacity = 0;
+    for (size_t i = 0; i < frame->mNalus.size(); ++i)
+        capacity += naluPacketSpace(frame->mNalus[i].mSize);
 
-    RtpHeader* rtpHeader = mRtpPacket.mRtpHeader;
-    uint8_t naluType = frame->mBuf[0];
+    RtpPacketListPtr packetList = std::make_shared<RtpPacketList>(capacity);
+    bool keyFrame = false;
+    bool reference = false;
 
-    if (frame->mSize <= RTP_MAX_PKT_SIZE)
+    size_t naluNum = frame->mNalus.size();
+    for (size_t i = 0; i < naluNum; ++i)
     {
-        memcpy(rtpHeader->payload, frame->mBuf, frame->mSize);
-        mRtpPacket.mSize = RTP_HEADER_SIZE + frame->mSize;
-        sendRtpPacket(&mRtpPacket);
-        mSeq++;
-
-        if ((naluType & 0x1F) == 7 || (naluType & 0x1F) == 8) // 如果是SPS、PPS就不需要加时间戳
-            return;
+        uint8_t naluType = frame->mNalus[i].mBuf[0];
+
+        // IDR和SPS/PPS可作为丢帧后的恢复点，nal_ref_idc为0的帧不被其他帧参考
+        int type = naluType & 0x1F;
+        if (type == 5 || type == 7 || type == 8)
+            keyFrame = true;
+        if (naluType & 0x60)
+            reference = true;
     }
-    else
+
+    size_t i = 0;
+    while (i < naluNum)
     {
-        int pktNum = frame->mSize / RTP_MAX_PKT_SIZE;       // 有几个完整的包
-        int remainPktSize = frame->mSize % RTP_MAX_PKT_SIZE; // 剩余不完整包的大小
-        int i, pos = 1;
-
-        /* 发送完整的包 */
-        for (i = 0; i < pktNum; i++)
-        {
-            /*
-            *     FU Indicator
-            *    0 1 2 3 4 5 6 7
-            *   +-+-+-+-+-+-+-+-+
-            *   |F|NRI|  Type   |
-            *   +---------------+
-            * */
-            rtpHeader->payload[0] = (naluType & 0x60) | 28; //(naluType & 0x60)表示nalu的重要性，28表示为分片
-
-            /*
-            *      FU Header
-            *    0 1 2 3 4 5 6 7
-            *   +-+-+-+-+-+-+-+-+
-            *   |S|E|R|  Type   |
-            *   +---------------+
-            * */
-            rtpHeader->payload[1] = naluType & 0x1F;
-
-            if (i == 0) //第一包数据
-                rtpHeader->payload[1] |= 0x80; // start
-            else if (remainPktSize == 0 && i == pktNum - 1) //最后一包数据
-                rtpHeader->payload[1] |= 0x40; // end
-
-            memcpy(rtpHeader->payload + 2, frame->mBuf + pos, RTP_MAX_PKT_SIZE);
-            mRtpPacket.mSize = RTP_HEADER_SIZE + 2 + RTP_MAX_PKT_SIZE;
-            sendRtpPacket(&mRtpPacket);
-
-            mSeq++;
-            pos += RTP_MAX_PKT_SIZE;
+        if (mStapA) {
+            // 从i开始尽量多地聚合连续的nalu：1字节STAP-A头，每个nalu前加2字节长度
+            int payloadSize = 1;
+            size_t j = i;
+            while (j < naluNum && payloadSize + 2 + frame->mNalus[j].mSize <= RTP_MAX_PKT_SIZE) {
+                payloadSize += 2 + frame->mNalus[j].mSize;
+                ++j;
+            }
+
+            if (j - i >= 2) {
+                addStapA(packetList.get(), &frame->mNalus[i], (int)(j - i), j == naluNum);
+                i = j;
+                continue;
+            }
         }
 
-        /* 发送剩余的数据 */
-        if (remainPktSize > 0)
-        {
-            rtpHeader->payload[0] = (naluType & 0x60) | 28;
-            rtpHeader->payload[1] = naluType & 0x1F;
-            rtpHeader->payload[1] |= 0x40; //end
+        addNalu(packetList.get(), frame->mNalus[i].mBuf, frame->mNalus[i].mSize, i == naluNum - 1);
+        ++i;
+    }
 
-            memcpy(rtpHeader->payload + 2, frame->mBuf + pos, remainPktSize);
-            mRtpPacket.mSize = RTP_HEADER_SIZE + 2 + remainPktSize;
-            sendRtpPacket(&mRtpPacket);
+    packetList->setFrameType(keyFrame, reference);
+    sendRtpPacketList(packetList);
 
-            mSeq++;
-        }
+    ++mPictureCount;
+    mTimestamp = (uint32_t)(mPictureCount * mClockRate * mFrameRateDen / mFrameRateNum);
+}
+
+// 聚合后的包不会比逐个单包发送更大，封包空间按单包计算即可
+void H264FileSink::addStapA(RtpPacketList* packetList, const MediaFrame::Nalu* nalus, int num, bool lastNalu)
+{
+    int payloadSize = 1;
+    uint8_t fnri = 0;// F取或，NRI取最大值
+    for (int i = 0; i < num; ++i) {
+        payloadSize += 2 + nalus[i].mSize;
+        fnri |= nalus[i].mBuf[0] & 0x80;
+        if ((nalus[i].mBuf[0] & 0x60) > (fnri & 0x60))
+            fnri = (fnri & 0x80) | (nalus[i].mBuf[0] & 0x60);
     }
 
-    mTimestamp += mClockRate / mFps;
-    
-   
+    mMarker = lastNalu ? 1 : 0;
+    RtpHeader* rtpHeader = packetList->addPacket(RTP_HEADER_SIZE + payloadSize);
+    setRtpHeader(rtpHeader);
+
+    /*
+    *     STAP-A header    NALU 1 size   NALU 1    NALU 2 size   NALU 2 ...
+    *   +-+-+-+-+-+-+-+-+ +-------------+---------+-------------+---------+
+    *   |F|NRI|  Type=24| |   16 bits   |         |   16 bits   |         |
+    *   +---------------+ +-------------+---------+-------------+---------+
+    * */
+    uint8_t* payload = rtpHeader->payload;
+    *payload++ = fnri | 24;
+    for (int i = 0; i < num; ++i) {
+        *payload++ = (nalus[i].mSize >> 8) & 0xFF;
+        *payload++ = nalus[i].mSize & 0xFF;
+        memcpy(payload, nalus[i].mBuf, nalus[i].mSize);
+        payload += nalus[i].mSize;
+    }
 
+    mSeq++;
+}
+
+// 访问单元的最后一个包设置marker
+void H264FileSink::addNalu(RtpPacketList* packetList, const uint8_t* buf, int size, bool lastNalu)
+{
+    uint8_t naluType = buf[0];
+
+    if (size <= RTP_MAX_PKT_SIZE)
+    {
+        mMarker = lastNalu ? 1 : 0;
+        RtpHeader* rtpHeader = packetList->addPacket(RTP_HEADER_SIZE + size);
+        setRtpHeader(rtpHeader);
+        memcpy(rtpHeader->payload, buf, size);
+        mSeq++;
+        return;
+    }
+
+    // FU-A分片：去掉1字节的nalu头，剩余数据按RTP_MAX_PKT_SIZE切分
+    int dataSize = size - 1;
+    int pktNum = (dataSize + RTP_MAX_PKT_SIZE - 1) / RTP_MAX_PKT_SIZE;
+    int pos = 1;
+
+    for (int i = 0; i < pktNum; i++)
+    {
+        int pktSize = size - pos;
+        if (pktSize > RTP_MAX_PKT_SIZE)
+            pktSize = RTP_MAX_PKT_SIZE;
+
+        mMarker = (lastNalu && i == pktNum - 1) ? 1 : 0;
+        RtpHeader* rtpHeader = packetList->addPacket(RTP_HEADER_SIZE + 2 + pktSize);
+        setRtpHeader(rtpHeader);
+
+        /*
+        *     FU Indicator
+        *    0 1 2 3 4 5 6 7
+        *   +-+-+-+-+-+-+-+-+
+        *   |F|NRI|  Type   |
+        *   +---------------+
+        * */
+        rtpHeader->payload[0] = (naluType & 0x60) | 28; //(naluType & 0x60)表示nalu的重要性，28表示为分片
+
+        /*
+        *      FU Header
+        *    0 1 2 3 4 5 6 7
+        *   +-+-+-+-+-+-+-+-+
+        *   |S|E|R|  Type   |
+        *   +---------------+
+        * */
+        rtpHeader->payload[1] = naluType & 0x1F;
+
+        if (i == 0) //第一包数据
+            rtpHeader->payload[1] |= 0x80; // start
+        if (i == pktNum - 1) //最后一包数据
+            rtpHeader->payload[1] |= 0x40; // end
+
+        memcpy(rtpHeader->payload + 2, buf + pos, pktSize);
+
+        mSeq++;
+        pos += pktSize;
+    }
 }
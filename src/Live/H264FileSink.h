@@ -3,24 +3,33 @@
 
 #include <stdint.h>
 #include "Sink.h"
+#include "H264FileMediaSource.h"
 
 
 
 class H264FileSink : public Sink
 {
 public:
-    static H264FileSink* createNew(UsageEnvironment* env, MediaSource* mediaSource);
+    // stapA为true时，同一访问单元中连续的小nalu聚合成STAP-A包（RFC 6184 5.7.1）
+    static H264FileSink* createNew(UsageEnvironment* env, H264FileMediaSource* mediaSource, bool stapA = false);
 
-    H264FileSink(UsageEnvironment* env, MediaSource* mediaSource);
+    H264FileSink(UsageEnvironment* env, H264FileMediaSource* mediaSource, bool stapA);
     virtual ~H264FileSink();
     virtual std::string getMediaDescription(uint16_t port);
     virtual std::string getAttribute();
     virtual void sendFrame(MediaFrame* frame);
 
 private:
-    RtpPacket mRtpPacket;
+    void addNalu(RtpPacketList* packetList, const uint8_t* buf, int size, bool lastNalu);
+    void addStapA(RtpPacketList* packetList, const MediaFrame::Nalu* nalus, int num, bool lastNalu);
+
+private:
+    H264FileMediaSource* mH264Source;
     int mClockRate;
-    int mFps;
+    uint32_t mFrameRateNum;
+    uint32_t mFrameRateDen;
+    uint64_t mPictureCount;// 已发送的图像数，时间戳按它计算，非整数帧率也不会累计误差
+    bool mStapA;
 
 };
 
@@ -0,0 +1,139 @@
+﻿#include "H264Parser.h"
+#include <vector>
+#include "AnnexB.h"
+#include "BitReader.h"
+
+namespace h264
+{
+
+static void skipScalingList(BitReader& br, int size)
+{
+    int lastScale = 8;
+    int nextScale = 8;
+    for (int i = 0; i < size; ++i) {
+        if (nextScale != 0) {
+            int deltaScale = br.readSe();
+            nextScale = (lastScale + deltaScale + 256) % 256;
+        }
+        lastScale = (nextScale == 0) ? lastScale : nextScale;
+    }
+}
+
+// 只解析到VUI中的timing_info，参考H.264 7.3.2.1.1和E.1.1
+static void parseVui(BitReader& br, SpsInfo* info)
+{
+    if (br.readBit()) {// aspect_ratio_info_present_flag
+        if (br.readBits(8) == 255)// aspect_ratio_idc == Extended_SAR
+            br.skipBits(32);// sar_width, sar_height
+    }
+    if (br.readBit())// overscan_info_present_flag
+        br.skipBits(1);
+    if (br.readBit()) {// video_signal_type_present_flag
+        br.skipBits(4);// video_format, video_full_range_flag
+        if (br.readBit())// colour_description_present_flag
+            br.skipBits(24);
+    }
+    if (br.readBit()) {// chroma_loc_info_present_flag
+        br.readUe();
+        br.readUe();
+    }
+    if (br.readBit()) {// timing_info_present_flag
+        uint32_t numUnitsInTick = br.readBits(32);
+        uint32_t timeScale = br.readBits(32);
+        if (!br.error() && numUnitsInTick > 0 && timeScale > 0) {
+            // 一帧为两个场（tick），帧率 = time_scale / (2 * num_units_in_tick)
+            info->mFrameRateNum = timeScale;
+            info->mFrameRateDen = 2 * numUnitsInTick;
+        }
+    }
+}
+
+bool parseSps(const uint8_t* nalu, int size, SpsInfo* info)
+{
+    if (size < 4 || (nalu[0] & 0x1F) != 7)
+        return false;
+
+    std::vector<uint8_t> rbsp(size);
+    int rbspSize = annexb::removeEmulationPrevention(nalu + 1, size - 1, &rbsp[0]);
+    BitReader br(&rbsp[0], rbspSize);
+
+    info->mProfileIdc = br.readBits(8);
+    info->mConstraintFlags = br.readBits(8);
+    info->mLevelIdc = br.readBits(8);
+    info->mFrameRateNum = 0;
+    info->mFrameRateDen = 0;
+    br.readUe();// seq_parameter_set_id
+
+    uint32_t chromaFormatIdc = 1;
+    uint32_t separateColourPlane = 0;
+    uint8_t profile = info->mProfileIdc;
+    if (profile == 100 || profile == 110 || profile == 122 || profile == 244 || profile == 44 ||
+        profile == 83 || profile == 86 || profile == 118 || profile == 128 || profile == 138 ||
+        profile == 139 || profile == 134 || profile == 135) {
+        chromaFormatIdc = br.readUe();
+        if (chromaFormatIdc == 3)
+            separateColourPlane = br.readBit();
+        br.readUe();// bit_depth_luma_minus8
+        br.readUe();// bit_depth_chroma_minus8
+        br.readBit();// qpprime_y_zero_transform_bypass_flag
+        if (br.readBit()) {// seq_scaling_matrix_present_flag
+            int num = (chromaFormatIdc != 3) ? 8 : 12;
+            for (int i = 0; i < num; ++i) {
+                if (br.readBit())
+                    skipScalingList(br, i < 6 ? 16 : 64);
+            }
+        }
+    }
+
+    br.readUe();// log2_max_frame_num_minus4
+    uint32_t pocType = br.readUe();
+    if (pocType == 0) {
+        br.readUe();// log2_max_pic_order_cnt_lsb_minus4
+    }
+    else if (pocType == 1) {
+        br.readBit();// delta_pic_order_always_zero_flag
+        br.readSe();// offset_for_non_ref_pic
+        br.readSe();// offset_for_top_to_bottom_field
+        uint32_t num = br.readUe();
+        for (uint32_t i = 0; i < num && !br.error(); ++i)
+            br.readSe();
+    }
+
+    br.readUe();// max_num_ref_frames
+    br.readBit();// gaps_in_frame_num_value_allowed_flag
+    uint32_t widthInMbs = br.readUe() + 1;
+    uint32_t heightInMapUnits = br.readUe() + 1;
+    uint32_t frameMbsOnly = br.readBit();
+    if (!frameMbsOnly)
+        br.readBit();// mb_adaptive_frame_field_flag
+    br.readBit();// direct_8x8_inference_flag
+
+    uint32_t cropLeft = 0, cropRight = 0, cropTop = 0, cropBottom = 0;
+    if (br.readBit()) {// frame_cropping_flag
+        cropLeft = br.readUe();
+        cropRight = br.readUe();
+        cropTop = br.readUe();
+        cropBottom = br.readUe();
+    }
+
+    // 裁剪以色度采样为单位，见H.264 7.4.2.1.1
+    uint32_t cropUnitX = 1;
+    uint32_t cropUnitY = 2 - frameMbsOnly;
+    if (chromaFormatIdc != 0 && !separateColourPlane) {
+        cropUnitX = (chromaFormatIdc == 3) ? 1 : 2;
+        cropUnitY *= (chromaFormatIdc == 1) ? 2 : 1;
+    }
+    info->mWidth = widthInMbs * 16 - (cropLeft + cropRight) * cropUnitX;
+    info->mHeight = (2 - frameMbsOnly) * heightInMapUnits * 16 - (cropTop + cropBottom) * cropUnitY;
+
+    if (br.error() || info->mWidth <= 0 || info->mHeight <= 0)
+        return false;
+
+    // VUI只用于获取帧率，解析失败不影响其他字段
+    if (br.readBit())// vui_parameters_present_flag
+        parseVui(br, info);
+
+    return true;
+}
+
+}
@@ -0,0 +1,22 @@
+﻿#ifndef ZYX_RTSPSERVER_H264PARSER_H
+#define ZYX_RTSPSERVER_H264PARSER_H
+#include <stdint.h>
+
+namespace h264
+{
+    struct SpsInfo
+    {
+        uint8_t mProfileIdc;
+        uint8_t mConstraintFlags;// constraint_set0..5_flag及保留位，即profile-level-id的第二个字节
+        uint8_t mLevelIdc;
+        int mWidth;// 已减去裁剪
+        int mHeight;
+        uint32_t mFrameRateNum;// VUI中的帧率 mFrameRateNum/mFrameRateDen，没有时为0
+        uint32_t mFrameRateDen;
+    };
+
+    // nalu不含起始码，包含1字节nalu头
+    bool parseSps(const uint8_t* nalu, int size, SpsInfo* info);
+}
+
+#endif //ZYX_RTSPSERVER_H264PARSER_H
@@ -0,0 +1,198 @@
+﻿#include "H265FileMediaSource.h"
+#include "AnnexB.h"
+#include "../Base/Log.h"
+
+H265FileMediaSource* H265FileMediaSource::createNew(UsageEnvironment* env, const std::string& file, int frameNum)
+{
+    return new H265FileMediaSource(env, file, frameNum);
+}
+
+H265FileMediaSource::H265FileMediaSource(UsageEnvironment* env, const std::string& file, int frameNum) :
+    MediaSource(env, frameNum),
+    mNextAu(0),
+    mHasSpsInfo(false),
+    mFrameRateNum(25),
+    mFrameRateDen(1) {
+
+    mSourceName = file;
+
+    mFile = MappedFile::createNew(file);
+    if (mFile == nullptr) {
+        LOGE("Failed to open file");
+    }
+    else {
+        LOGI("Succuss open H265File");
+        mFile->prefault();
+        buildIndex();
+        parseParameterSets();
+    }
+
+    // 按整数帧率四舍五入，精确的帧率通过getFrameRateNum()/getFrameRateDen()获取
+    setFps((mFrameRateNum + mFrameRateDen / 2) / mFrameRateDen);
+
+    requestFrames();// 开始预读，填满帧环形队列
+}
+
+H265FileMediaSource::~H265FileMediaSource()
+{
+    delete mFile;
+}
+
+// 按H.265 7.4.2.4.4判断nalu是否开始一个新的访问单元，hasVcl表示当前访问单元中已有图像数据
+bool H265FileMediaSource::isNewAccessUnit(const uint8_t* nalu, int size, bool hasVcl)
+{
+    if (!hasVcl)
+        return false;
+
+    uint8_t type = (nalu[0] >> 1) & 0x3F;
+    if (type < 32)// VCL：新图像的第一个slice segment，first_slice_segment_in_pic_flag为1
+        return size > 2 && (nalu[2] & 0x80);
+
+    // VPS、SPS、PPS、AUD、前缀SEI及保留类型出现在图像数据之后时开始新的访问单元，后缀SEI(40)属于当前访问单元
+    return (type >= 32 && type <= 35) || type == 39 || (type >= 41 && type <= 44) ||
+           (type >= 48 && type <= 55);
+}
+
+// 一次扫描整个文件，记录每个nalu的位置和类型并划分访问单元
+void H265FileMediaSource::buildIndex()
+{
+    const uint8_t* data = mFile->data();
+    const uint8_t* end = data + mFile->size();
+    const uint8_t* cur = annexb::findStartCode(data, end);
+    bool hasVcl = false;
+
+    while (cur)
+    {
+        int startCodeNum = (cur[2] == 1) ? 3 : 4;// findStartCode返回的位置一定是3或4字节起始码
+        const uint8_t* nalu = cur + startCodeNum;
+        const uint8_t* next = annexb::findStartCode(nalu, end);
+        const uint8_t* naluEnd = next ? next : end;
+        cur = next;
+
+        if (naluEnd - nalu < 2)// 至少要有2字节nalu头
+            continue;
+
+        NaluIndex index;
+        index.mOffset = nalu - data;
+        index.mSize = (int)(naluEnd - nalu);
+        index.mType = (nalu[0] >> 1) & 0x3F;
+        index.mIsIrap = index.mType >= 16 && index.mType <= 23;
+
+        if (mAccessUnits.empty() || isNewAccessUnit(nalu, index.mSize, hasVcl)) {
+            AccessUnit au;
+            au.mFirstNalu = mNalus.size();
+            au.mNaluNum = 0;
+            au.mIsKey = false;
+            mAccessUnits.push_back(au);
+            hasVcl = false;
+        }
+
+        // 35表示分隔符 NAL 单元，只用于划分访问单元，不需要发送
+        if (index.mType == 35)
+            continue;
+
+        AccessUnit& au = mAccessUnits.back();
+        au.mNaluNum++;
+        if (index.mIsIrap)
+            au.mIsKey = true;
+        if (index.mType < 32)
+            hasVcl = true;
+
+        mNalus.push_back(index);
+    }
+
+    // 去掉只有分隔符的访问单元
+    for (size_t i = 0; i < mAccessUnits.size();) {
+        if (mAccessUnits[i].mNaluNum == 0)
+            mAccessUnits.erase(mAccessUnits.begin() + i);
+        else
+            ++i;
+    }
+
+    if (mAccessUnits.empty())
+        LOGE("Read %s error, no startCode3 and no startCode4", mSourceName.c_str());
+    else
+        LOGI("%s nalus=%d,access units=%d", mSourceName.c_str(), (int)mNalus.size(), (int)mAccessUnits.size());
+}
+
+void H265FileMediaSource::parseParameterSets()
+{
+    for (size_t i = 0; i < mNalus.size() && (mVps.empty() || mSps.empty() || mPps.empty()); ++i)
+    {
+        const NaluIndex& index = mNalus[i];
+        const char* nalu = (const char*)mFile->data() + index.mOffset;
+        if (index.mType == 32 && mVps.empty())
+            mVps.assign(nalu, index.mSize);
+        else if (index.mType == 33 && mSps.empty())
+            mSps.assign(nalu, index.mSize);
+        else if (index.mType == 34 && mPps.empty())
+            mPps.assign(nalu, index.mSize);
+    }
+
+    if (!mVps.empty()) {
+        uint32_t num, den;
+        if (h265::parseVpsFrameRate((const uint8_t*)mVps.data(), (int)mVps.size(), &num, &den)) {
+            mFrameRateNum = num;
+            mFrameRateDen = den;
+        }
+    }
+
+    if (mSps.empty()) {
+        LOGE("%s no sps", mSourceName.c_str());
+        return;
+    }
+
+    mHasSpsInfo = h265::parseSps((const uint8_t*)mSps.data(), (int)mSps.size(), &mSpsInfo);
+    if (!mHasSpsInfo) {
+        LOGE("%s parse sps error", mSourceName.c_str());
+        return;
+    }
+
+    LOGI("%s profile=%d,level=%d,%dx%d,fps=%u/%u", mSourceName.c_str(), mSpsInfo.mProfileIdc,
+         mSpsInfo.mLevelIdc, mSpsInfo.mWidth, mSpsInfo.mHeight, mFrameRateNum, mFrameRateDen);
+}
+
+bool H265FileMediaSource::readFrame(MediaFrame* frame)
+{
+    std::lock_guard <std::mutex> lck(mMtx);// 只与seek()竞争，Sink取帧不需要这把锁
+
+    if (mAccessUnits.empty())
+        return false;
+
+    // 零拷贝：frame直接引用映射内存中的nalu（不含起始码），映射只读，发送方不能修改
+    const AccessUnit& au = mAccessUnits[mNextAu];
+    frame->mNalus.clear();
+    for (int i = 0; i < au.mNaluNum; ++i) {
+        const NaluIndex& index = mNalus[au.mFirstNalu + i];
+        MediaFrame::Nalu nalu;
+        nalu.mBuf = (uint8_t*)mFile->data() + index.mOffset;
+        nalu.mSize = index.mSize;
+        frame->mNalus.push_back(nalu);
+    }
+    frame->mBuf = frame->mNalus[0].mBuf;
+    frame->mSize = frame->mNalus[0].mSize;
+
+    if (++mNextAu == mAccessUnits.size())
+        mNextAu = 0;
+
+    return true;
+}
+
+bool H265FileMediaSource::seek(int64_t ms)
+{
+    std::lock_guard <std::mutex> lck(mMtx);
+
+    if (mAccessUnits.empty() || ms < 0)
+        return false;
+
+    // 每个访问单元一帧
+    size_t target = (size_t)(ms * mFrameRateNum / mFrameRateDen / 1000);
+    if (target >= mAccessUnits.size())
+        target = mAccessUnits.size() - 1;
+
+    while (target > 0 && !mAccessUnits[target].mIsKey)
+        --target;
+
+    mNextAu = target;
+    return true;
+}
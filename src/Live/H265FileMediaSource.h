@@ -0,0 +1,73 @@
+#ifndef ZYX_RTSPSERVER_H265FILEMEDIASOURCE_H
+#define ZYX_RTSPSERVER_H265FILEMEDIASOURCE_H
+
+
+#include <string>
+#include <vector>
+#include "MediaSource.h"
+#include "MappedFile.h"
+#include "H265Parser.h"
+
+/*
+    H.265/HEVC裸流文件：与H264FileMediaSource相同，映射文件后一次建立nalu和访问单元索引，
+    每个MediaFrame是一个访问单元，nalu直接引用映射内存。nalu头为2字节。
+*/
+class H265FileMediaSource : public MediaSource
+{
+public:
+    static H265FileMediaSource* createNew(UsageEnvironment* env, const std::string& file, int frameNum = DEFAULT_FRAME_NUM);
+
+    H265FileMediaSource(UsageEnvironment* env, const std::string& file, int frameNum);
+    virtual ~H265FileMediaSource();
+
+    // 跳到不晚于ms的最近一个IRAP访问单元，已在输出队列中的帧仍会先发出
+    bool seek(int64_t ms);
+
+    // 打开时从码流中取得的第一组VPS/SPS/PPS（不含起始码），用于SDP，没有时为空
+    const std::string& getVps() const { return mVps; }
+    const std::string& getSps() const { return mSps; }
+    const std::string& getPps() const { return mPps; }
+    const h265::SpsInfo* getSpsInfo() const { return mHasSpsInfo ? &mSpsInfo : NULL; }
+    // 帧率 num/den：优先取VPS的timing_info，没有时为默认的25帧
+    uint32_t getFrameRateNum() const { return mFrameRateNum; }
+    uint32_t getFrameRateDen() const { return mFrameRateDen; }
+
+protected:
+    virtual bool readFrame(MediaFrame* frame);
+
+private:
+    struct NaluIndex
+    {
+        size_t mOffset;// 去掉起始码后nalu在文件中的偏移
+        int mSize;
+        uint8_t mType;
+        bool mIsIrap;// BLA/IDR/CRA，可作为随机访问点
+    };
+
+    struct AccessUnit
+    {
+        size_t mFirstNalu;
+        int mNaluNum;
+        bool mIsKey;// 包含IRAP
+    };
+
+    void buildIndex();
+    void parseParameterSets();
+    static bool isNewAccessUnit(const uint8_t* nalu, int size, bool hasVcl);
+
+private:
+    MappedFile* mFile;
+    std::vector<NaluIndex> mNalus;
+    std::vector<AccessUnit> mAccessUnits;
+    size_t mNextAu;// 下一个送入输出队列的访问单元，到结尾后回到开头循环播放
+
+    std::string mVps;
+    std::string mSps;
+    std::string mPps;
+    h265::SpsInfo mSpsInfo;
+    bool mHasSpsInfo;
+    uint32_t mFrameRateNum;
+    uint32_t mFrameRateDen;
+};
+
+#endif //ZYX_RTSPSERVER_H265FILEMEDIASOURCE_H
@@ -0,0 +1,242 @@
+﻿#include <stdio.h>
+#include <string.h>
+#include "H265FileSink.h"
+#include "../Base/Base64.h"
+#include "../Base/Log.h"
+
+H265FileSink* H265FileSink::createNew(UsageEnvironment* env, H265FileMediaSource* mediaSource, bool aggregate)
+{
+    if (!mediaSource)
+        return NULL;
+
+    return new H265FileSink(env, mediaSource, aggregate);
+}
+
+H265FileSink::H265FileSink(UsageEnvironment* env, H265FileMediaSource* mediaSource, bool aggregate) :
+        Sink(env, mediaSource, RTP_PAYLOAD_TYPE_H265),
+        mH265Source(mediaSource),
+        mClockRate(90000),
+        mFrameRateNum(mediaSource->getFrameRateNum()),
+        mFrameRateDen(mediaSource->getFrameRateDen()),
+        mPictureCount(0),
+        mAggregate(aggregate)
+{
+    LOGI("H265FileSink()");
+    setGopCacheEnabled(true);// 新的观看者从最近的IRAP开始解码
+    runEvery(mFrameRateDen, mFrameRateNum);
+}
+
+H265FileSink::~H265FileSink()
+{
+    LOGI("~H265FileSink()");
+}
+
+std::string H265FileSink::getMediaDescription(uint16_t port)
+{
+    char buf[100] = { 0 };
+    sprintf(buf, "m=video %hu RTP/AVP %d", port, mPayloadType);
+
+    return std::string(buf);
+}
+
+static std::string toBase64(const std::string& nalu)
+{
+    return base64Encode((const uint8_t*)nalu.data(), (int)nalu.size());
+}
+
+std::string H265FileSink::getAttribute()
+{
+    char buf[2048];
+    sprintf(buf, "a=rtpmap:%d H265/%d\r\n", mPayloadType, mClockRate);
+    sprintf(buf + strlen(buf), "a=fmtp:%d ", mPayloadType);
+
+    const h265::SpsInfo* info = mH265Source->getSpsInfo();
+    if (info)
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "profile-space=%d;profile-id=%d;tier-flag=%d;level-id=%d;",
+                 info->mProfileSpace, info->mProfileIdc, info->mTierFlag, info->mLevelIdc);
+
+    // 带上参数集，播放器不必等待带内的VPS/SPS/PPS即可初始化解码器
+    snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "sprop-vps=%s;sprop-sps=%s;sprop-pps=%s",
+             toBase64(mH265Source->getVps()).c_str(),
+             toBase64(mH265Source->getSps()).c_str(),
+             toBase64(mH265Source->getPps()).c_str());
+
+    if (info)
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "\r\na=framesize:%d %d-%d",
+                 mPayloadType, info->mWidth, info->mHeight);
+
+    if (mFrameRateNum % mFrameRateDen == 0)
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "\r\na=framerate:%u", mFrameRateNum / mFrameRateDen);
+    else
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "\r\na=framerate:%.2f",
+                 (double)mFrameRateNum / mFrameRateDen);
+
+    return std::string(buf);
+}
+
+// 一个nalu封包后占用的空间：单包发送或FU分片
+static int naluPacketSpace(int naluSize)
+{
+    if (naluSize <= RTP_MAX_PKT_SIZE)
+        return RtpPacketList::packetSpace(RTP_HEADER_SIZE + naluSize);
+
+    int pktNum = (naluSize - 2 + RTP_MAX_PKT_SIZE - 1) / RTP_MAX_PKT_SIZE;
+    return pktNum * RtpPacketList::packetSpace(RTP_HEADER_SIZE + 3 + RTP_MAX_PKT_SIZE);
+}
+
+void H265FileSink::sendFrame(MediaFrame* frame)
+{
+    // 一个访问单元封包到一个只读的RTP包列表中，所有包使用同一个时间戳，帧数据只拷贝一次
+    int capacity = 0;
+    for (size_t i = 0; i < frame->mNalus.size(); ++i)
+        capacity += naluPacketSpace(frame->mNalus[i].mSize);
+
+    RtpPacketListPtr packetList = std::make_shared<RtpPacketList>(capacity);
+    bool keyFrame = false;
+    bool reference = false;
+
+    size_t naluNum = frame->mNalus.size();
+    for (size_t i = 0; i < naluNum; ++i)
+    {
+        int type = (frame->mNalus[i].mBuf[0] >> 1) & 0x3F;
+
+        // IRAP和参数集可作为丢帧后的恢复点；类型0~14中的偶数为子层非参考图像，其余图像可能被参考
+        if ((type >= 16 && type <= 23) || (type >= 32 && type <= 34))
+            keyFrame = true;
+        if (type < 32 && !(type <= 14 && type % 2 == 0))
+            reference = true;
+    }
+
+    size_t i = 0;
+    while (i < naluNum)
+    {
+        if (mAggregate) {
+            // 从i开始尽量多地聚合连续的nalu：2字节AP头，每个nalu前加2字节长度
+            int payloadSize = 2;
+            size_t j = i;
+            while (j < naluNum && payloadSize + 2 + frame->mNalus[j].mSize <= RTP_MAX_PKT_SIZE) {
+                payloadSize += 2 + frame->mNalus[j].mSize;
+                ++j;
+            }
+
+            if (j - i >= 2) {
+                addAp(packetList.get(), &frame->mNalus[i], (int)(j - i), j == naluNum);
+                i = j;
+                continue;
+            }
+        }
+
+        addNalu(packetList.get(), frame->mNalus[i].mBuf, frame->mNalus[i].mSize, i == naluNum - 1);
+        ++i;
+    }
+
+    packetList->setFrameType(keyFrame, reference);
+    sendRtpPacketList(packetList);
+
+    ++mPictureCount;
+    mTimestamp = (uint32_t)(mPictureCount * mClockRate * mFrameRateDen / mFrameRateNum);
+}
+
+// 聚合后的包不会比逐个单包发送更大，封包空间按单包计算即可
+void H265FileSink::addAp(RtpPacketList* packetList, const MediaFrame::Nalu* nalus, int num, bool lastNalu)
+{
+    int payloadSize = 2;
+    uint8_t f = 0;
+    uint8_t layerId = 0x3F;
+    uint8_t tid = 7;
+    for (int i = 0; i < num; ++i) {
+        const uint8_t* hdr = nalus[i].mBuf;
+        uint8_t naluLayerId = ((hdr[0] & 0x01) << 5) | (hdr[1] >> 3);
+        uint8_t naluTid = hdr[1] & 0x07;
+
+        payloadSize += 2 + nalus[i].mSize;
+        f |= hdr[0] & 0x80;// F取或，LayerId和TID取最小值
+        if (naluLayerId < layerId)
+            layerId = naluLayerId;
+        if (naluTid < tid)
+            tid = naluTid;
+    }
+
+    mMarker = lastNalu ? 1 : 0;
+    RtpHeader* rtpHeader = packetList->addPacket(RTP_HEADER_SIZE + payloadSize);
+    setRtpHeader(rtpHeader);
+
+    /*
+    *     PayloadHdr (Type=48)   NALU 1 size   NALU 1   NALU 2 size   NALU 2 ...
+    *    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
+    *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+    *   |F|   Type    |  LayerId  | TID |
+    *   +-------------+-----------------+
+    * */
+    uint8_t* payload = rtpHeader->payload;
+    *payload++ = f | (48 << 1) | (layerId >> 5);
+    *payload++ = ((layerId & 0x1F) << 3) | tid;
+    for (int i = 0; i < num; ++i) {
+        *payload++ = (nalus[i].mSize >> 8) & 0xFF;
+        *payload++ = nalus[i].mSize & 0xFF;
+        memcpy(payload, nalus[i].mBuf, nalus[i].mSize);
+        payload += nalus[i].mSize;
+    }
+
+    mSeq++;
+}
+
+// 访问单元的最后一个包设置marker
+void H265FileSink::addNalu(RtpPacketList* packetList, const uint8_t* buf, int size, bool lastNalu)
+{
+    if (size <= RTP_MAX_PKT_SIZE)
+    {
+        mMarker = lastNalu ? 1 : 0;
+        RtpHeader* rtpHeader = packetList->addPacket(RTP_HEADER_SIZE + size);
+        setRtpHeader(rtpHeader);
+        memcpy(rtpHeader->payload, buf, size);
+        mSeq++;
+        return;
+    }
+
+    // FU分片：去掉2字节的nalu头，剩余数据按RTP_MAX_PKT_SIZE切分
+    int type = (buf[0] >> 1) & 0x3F;
+    int dataSize = size - 2;
+    int pktNum = (dataSize + RTP_MAX_PKT_SIZE - 1) / RTP_MAX_PKT_SIZE;
+    int pos = 2;
+
+    for (int i = 0; i < pktNum; i++)
+    {
+        int pktSize = size - pos;
+        if (pktSize > RTP_MAX_PKT_SIZE)
+            pktSize = RTP_MAX_PKT_SIZE;
+
+        mMarker = (lastNalu && i == pktNum - 1) ? 1 : 0;
+        RtpHeader* rtpHeader = packetList->addPacket(RTP_HEADER_SIZE + 3 + pktSize);
+        setRtpHeader(rtpHeader);
+
+        /*
+        *     PayloadHdr (Type=49)：F、LayerId、TID与原nalu头相同
+        *    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
+        *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+        *   |F|   Type    |  LayerId  | TID |
+        *   +-------------+-----------------+
+        * */
+        rtpHeader->payload[0] = (buf[0] & 0x81) | (49 << 1);
+        rtpHeader->payload[1] = buf[1];
+
+        /*
+        *      FU Header
+        *    0 1 2 3 4 5 6 7
+        *   +-+-+-+-+-+-+-+-+
+        *   |S|E|  FuType   |
+        *   +---------------+
+        * */
+        rtpHeader->payload[2] = type;
+
+        if (i == 0) //第一包数据
+            rtpHeader->payload[2] |= 0x80; // start
+        if (i == pktNum - 1) //最后一包数据
+            rtpHeader->payload[2] |= 0x40; // end
+
+        memcpy(rtpHeader->payload + 3, buf + pos, pktSize);
+
+        mSeq++;
+        pos += pktSize;
+    }
+}
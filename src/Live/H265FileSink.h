@@ -0,0 +1,36 @@
+#ifndef ZYX_RTSPSERVER_H265FILESINK_H
+#define ZYX_RTSPSERVER_H265FILESINK_H
+
+#include <stdint.h>
+#include "Sink.h"
+#include "H265FileMediaSource.h"
+
+
+
+class H265FileSink : public Sink
+{
+public:
+    // aggregate为true时，同一访问单元中连续的小nalu聚合成AP包（RFC 7798 4.4.2）
+    static H265FileSink* createNew(UsageEnvironment* env, H265FileMediaSource* mediaSource, bool aggregate = false);
+
+    H265FileSink(UsageEnvironment* env, H265FileMediaSource* mediaSource, bool aggregate);
+    virtual ~H265FileSink();
+    virtual std::string getMediaDescription(uint16_t port);
+    virtual std::string getAttribute();
+    virtual void sendFrame(MediaFrame* frame);
+
+private:
+    void addNalu(RtpPacketList* packetList, const uint8_t* buf, int size, bool lastNalu);
+    void addAp(RtpPacketList* packetList, const MediaFrame::Nalu* nalus, int num, bool lastNalu);
+
+private:
+    H265FileMediaSource* mH265Source;
+    int mClockRate;
+    uint32_t mFrameRateNum;
+    uint32_t mFrameRateDen;
+    uint64_t mPictureCount;// 已发送的图像数，时间戳按它计算
+    bool mAggregate;
+
+};
+
+#endif //ZYX_RTSPSERVER_H265FILESINK_H
@@ -0,0 +1,140 @@
+﻿#include "H265Parser.h"
+#include <stddef.h>
+#include <vector>
+#include "AnnexB.h"
+#include "BitReader.h"
+
+namespace h265
+{
+
+// profile_tier_level(1, maxSubLayersMinus1)，参考H.265 7.3.3
+static void parseProfileTierLevel(BitReader& br, int maxSubLayersMinus1, SpsInfo* info)
+{
+    uint8_t profileSpace = br.readBits(2);
+    uint8_t tierFlag = br.readBits(1);
+    uint8_t profileIdc = br.readBits(5);
+    br.skipBits(32);// general_profile_compatibility_flag[32]
+    br.skipBits(48);// progressive/interlaced/non_packed/frame_only及43位约束、1位保留
+    uint8_t levelIdc = br.readBits(8);
+
+    if (info) {
+        info->mProfileSpace = profileSpace;
+        info->mTierFlag = tierFlag;
+        info->mProfileIdc = profileIdc;
+        info->mLevelIdc = levelIdc;
+    }
+
+    bool subLayerProfilePresent[8] = { false };
+    bool subLayerLevelPresent[8] = { false };
+    for (int i = 0; i < maxSubLayersMinus1; ++i) {
+        subLayerProfilePresent[i] = br.readBit();
+        subLayerLevelPresent[i] = br.readBit();
+    }
+    if (maxSubLayersMinus1 > 0) {
+        for (int i = maxSubLayersMinus1; i < 8; ++i)
+            br.skipBits(2);// reserved_zero_2bits
+    }
+    for (int i = 0; i < maxSubLayersMinus1; ++i) {
+        if (subLayerProfilePresent[i])
+            br.skipBits(88);
+        if (subLayerLevelPresent[i])
+            br.skipBits(8);
+    }
+}
+
+static int toRbsp(const uint8_t* nalu, int size, std::vector<uint8_t>& rbsp)
+{
+    rbsp.resize(size);
+    return annexb::removeEmulationPrevention(nalu + 2, size - 2, &rbsp[0]);// 跳过2字节nalu头
+}
+
+bool parseSps(const uint8_t* nalu, int size, SpsInfo* info)
+{
+    if (size < 4 || ((nalu[0] >> 1) & 0x3F) != 33)
+        return false;
+
+    std::vector<uint8_t> rbsp;
+    int rbspSize = toRbsp(nalu, size, rbsp);
+    BitReader br(&rbsp[0], rbspSize);
+
+    br.skipBits(4);// sps_video_parameter_set_id
+    int maxSubLayersMinus1 = br.readBits(3);
+    br.skipBits(1);// sps_temporal_id_nesting_flag
+    parseProfileTierLevel(br, maxSubLayersMinus1, info);
+
+    br.readUe();// sps_seq_parameter_set_id
+    uint32_t chromaFormatIdc = br.readUe();
+    uint32_t separateColourPlane = 0;
+    if (chromaFormatIdc == 3)
+        separateColourPlane = br.readBit();
+    uint32_t width = br.readUe();
+    uint32_t height = br.readUe();
+
+    // conformance window以色度采样为单位，见H.265 7.4.3.2.1
+    if (br.readBit()) {
+        uint32_t left = br.readUe();
+        uint32_t right = br.readUe();
+        uint32_t top = br.readUe();
+        uint32_t bottom = br.readUe();
+
+        uint32_t subWidthC = 1;
+        uint32_t subHeightC = 1;
+        if (!separateColourPlane && (chromaFormatIdc == 1 || chromaFormatIdc == 2))
+            subWidthC = 2;
+        if (!separateColourPlane && chromaFormatIdc == 1)
+            subHeightC = 2;
+
+        width -= (left + right) * subWidthC;
+        height -= (top + bottom) * subHeightC;
+    }
+
+    info->mWidth = (int)width;
+    info->mHeight = (int)height;
+    return !br.error() && info->mWidth > 0 && info->mHeight > 0;
+}
+
+bool parseVpsFrameRate(const uint8_t* nalu, int size, uint32_t* num, uint32_t* den)
+{
+    if (size < 4 || ((nalu[0] >> 1) & 0x3F) != 32)
+        return false;
+
+    std::vector<uint8_t> rbsp;
+    int rbspSize = toRbsp(nalu, size, rbsp);
+    BitReader br(&rbsp[0], rbspSize);
+
+    // H.265 7.3.2.1
+    br.skipBits(4);// vps_video_parameter_set_id
+    br.skipBits(2);// vps_base_layer_internal_flag, vps_base_layer_available_flag
+    br.skipBits(6);// vps_max_layers_minus1
+    int maxSubLayersMinus1 = br.readBits(3);
+    br.skipBits(1);// vps_temporal_id_nesting_flag
+    br.skipBits(16);// vps_reserved_0xffff_16bits
+    parseProfileTierLevel(br, maxSubLayersMinus1, NULL);
+
+    bool subLayerOrderingInfoPresent = br.readBit();
+    for (int i = subLayerOrderingInfoPresent ? 0 : maxSubLayersMinus1; i <= maxSubLayersMinus1; ++i) {
+        br.readUe();// vps_max_dec_pic_buffering_minus1
+        br.readUe();// vps_max_num_reorder_pics
+        br.readUe();// vps_max_latency_increase_plus1
+    }
+
+    int maxLayerId = br.readBits(6);
+    uint32_t numLayerSetsMinus1 = br.readUe();
+    for (uint32_t i = 1; i <= numLayerSetsMinus1 && !br.error(); ++i)
+        br.skipBits(maxLayerId + 1);// layer_id_included_flag
+
+    if (!br.readBit())// vps_timing_info_present_flag
+        return false;
+
+    uint32_t numUnitsInTick = br.readBits(32);
+    uint32_t timeScale = br.readBits(32);
+    if (br.error() || numUnitsInTick == 0 || timeScale == 0)
+        return false;
+
+    // 与H.264不同，H.265的一个tick对应一帧
+    *num = timeScale;
+    *den = numUnitsInTick;
+    return true;
+}
+
+}
@@ -0,0 +1,24 @@
+﻿#ifndef ZYX_RTSPSERVER_H265PARSER_H
+#define ZYX_RTSPSERVER_H265PARSER_H
+#include <stdint.h>
+
+namespace h265
+{
+    struct SpsInfo
+    {
+        uint8_t mProfileSpace;// 对应SDP中的profile-space、tier-flag、profile-id、level-id
+        uint8_t mTierFlag;
+        uint8_t mProfileIdc;
+        uint8_t mLevelIdc;
+        int mWidth;// 已减去conformance window
+        int mHeight;
+    };
+
+    // nalu不含起始码，包含2字节nalu头
+    bool parseSps(const uint8_t* nalu, int size, SpsInfo* info);
+
+    // 从VPS的timing_info取得帧率 num/den，没有时返回false
+    bool parseVpsFrameRate(const uint8_t* nalu, int size, uint32_t* num, uint32_t* den);
+}
+
+#endif //ZYX_RTSPSERVER_H265PARSER_H
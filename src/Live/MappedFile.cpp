@@ -0,0 +1,93 @@
+﻿#include "MappedFile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif // !WIN32
+#include "../Base/Log.h"
+
+MappedFile* MappedFile::createNew(const std::string& path)
+{
+    MappedFile* file = new MappedFile();
+    if (!file->open(path)) {
+        delete file;
+        return NULL;
+    }
+    return file;
+}
+
+MappedFile::MappedFile() :
+    mData(NULL),
+    mSize(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    if (!mData)
+        return;
+#ifndef WIN32
+    munmap(mData, mSize);
+#else
+    free(mData);
+#endif // !WIN32
+}
+
+bool MappedFile::open(const std::string& path)
+{
+#ifndef WIN32
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGE("open %s error", path.c_str());
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        LOGE("%s is empty or stat error", path.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);// 映射建立后描述符可以关闭
+    if (addr == MAP_FAILED) {
+        LOGE("mmap %s error", path.c_str());
+        return false;
+    }
+
+    mData = (uint8_t*)addr;
+    mSize = st.st_size;
+#else
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        LOGE("open %s error", path.c_str());
+        return false;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0) {
+        LOGE("%s is empty", path.c_str());
+        fclose(fp);
+        return false;
+    }
+
+    mData = (uint8_t*)malloc(size);
+    mSize = fread(mData, 1, size, fp);
+    fclose(fp);
+#endif // !WIN32
+
+    return true;
+}
+
+void MappedFile::prefault()
+{
+#ifndef WIN32
+    madvise(mData, mSize, MADV_WILLNEED);
+#endif // !WIN32
+}
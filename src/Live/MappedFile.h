@@ -0,0 +1,32 @@
+﻿#ifndef ZYX_RTSPSERVER_MAPPEDFILE_H
+#define ZYX_RTSPSERVER_MAPPEDFILE_H
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+    只读映射整个媒体文件，帧数据直接引用映射内存，不再逐帧fread和拷贝。
+    WIN32下没有mmap，一次性读入内存，接口不变。
+*/
+class MappedFile
+{
+public:
+    static MappedFile* createNew(const std::string& path);// 打开或映射失败返回NULL
+
+    ~MappedFile();
+
+    const uint8_t* data() const { return mData; }
+    size_t size() const { return mSize; }
+
+    void prefault();// 提示内核预读整个文件，避免发送时缺页
+
+private:
+    MappedFile();
+    bool open(const std::string& path);
+
+private:
+    uint8_t* mData;
+    size_t mSize;
+};
+
+#endif //ZYX_RTSPSERVER_MAPPEDFILE_H
@@ -0,0 +1,94 @@
+﻿#include "MediaRegistry.h"
+#include <algorithm>
+#include "H264FileMediaSource.h"
+#include "H264FileSink.h"
+#include "H265FileMediaSource.h"
+#include "H265FileSink.h"
+#include "AACFileMediaSource.h"
+#include "AACFileSink.h"
+#include "../Base/Log.h"
+
+static std::string getExtension(const std::string& uri)
+{
+    std::string::size_type pos = uri.rfind('.');
+    if (pos == std::string::npos)
+        return "";
+
+    std::string ext = uri.substr(pos + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+MediaRegistry* MediaRegistry::createNew(UsageEnvironment* env)
+{
+    return new MediaRegistry(env);
+}
+
+MediaRegistry::MediaRegistry(UsageEnvironment* env) :
+    mEnv(env)
+{
+    LOGI("MediaRegistry()");
+}
+
+MediaRegistry::~MediaRegistry()
+{
+    LOGI("~MediaRegistry()");
+    while (!mSinks.empty()) {
+        delete mSinks.begin()->second;// Sink析构时会调用removeSink从mSinks中删除
+    }
+}
+
+Sink* MediaRegistry::getSink(const std::string& uri, bool aggregate)
+{
+    std::string ext = getExtension(uri);
+    bool isH264 = (ext == "h264" || ext == "264");
+    bool isH265 = (ext == "h265" || ext == "265" || ext == "hevc");
+
+    // 封包方式是Sink的属性，共享Sink的会话封包方式必须相同
+    std::string key = uri;
+    if (aggregate)
+        key += "#aggregate";
+
+    std::map<std::string, Sink*>::iterator it = mSinks.find(key);
+    if (it != mSinks.end())
+        return it->second;
+
+    Sink* sink = NULL;
+
+    if (isH264) {
+        H264FileMediaSource* source = H264FileMediaSource::createNew(mEnv, uri);
+        sink = H264FileSink::createNew(mEnv, source, aggregate);
+    }
+    else if (isH265) {
+        H265FileMediaSource* source = H265FileMediaSource::createNew(mEnv, uri);
+        sink = H265FileSink::createNew(mEnv, source, aggregate);
+    }
+    else if (ext == "aac") {
+        AACFileMeidaSource* source = AACFileMeidaSource::createNew(mEnv, uri);
+        sink = AACFileSink::createNew(mEnv, source, aggregate);
+    }
+    else {
+        LOGE("unsupported media uri=%s", uri.data());
+        return NULL;
+    }
+
+    if (!sink)
+        return NULL;
+
+    sink->setRegistry(this);
+    mSinks.insert(std::make_pair(key, sink));
+    LOGI("media registered uri=%s,num=%d", key.data(), (int)mSinks.size());
+
+    return sink;
+}
+
+void MediaRegistry::removeSink(Sink* sink)
+{
+    for (std::map<std::string, Sink*>::iterator it = mSinks.begin(); it != mSinks.end(); ++it) {
+        if (it->second == sink) {
+            LOGI("media unregistered uri=%s", it->first.data());
+            mSinks.erase(it);
+            return;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+﻿#ifndef ZYX_RTSPSERVER_MEDIAREGISTRY_H
+#define ZYX_RTSPSERVER_MEDIAREGISTRY_H
+#include <map>
+#include <string>
+#include "../Scheduler/UsageEnvironment.h"
+
+class Sink;
+
+/*
+    媒体注册表：按URI（文件路径）去重MediaSource和Sink。
+    同一URI无论被多少个MediaSession引用，都只有一个读取者、一个定时器和一次RTP封包，
+    封好的RTP包由Sink依次交给每个订阅的MediaSession，再由各自的RtpInstance发送。
+    与Sink的定时器在同一个线程中使用。
+*/
+class MediaRegistry
+{
+public:
+    static MediaRegistry* createNew(UsageEnvironment* env);
+
+    explicit MediaRegistry(UsageEnvironment* env);
+    ~MediaRegistry();
+
+    // 按文件扩展名创建对应的MediaSource和Sink，已存在则直接返回
+    // aggregate：是否聚合发送（H.264为STAP-A，H.265为AP，AAC为一个包多个AU），聚合方式不同的会话使用各自的Sink
+    Sink* getSink(const std::string& uri, bool aggregate = false);
+    void removeSink(Sink* sink);// Sink析构时调用
+
+private:
+    UsageEnvironment* mEnv;
+    std::map<std::string, Sink*> mSinks;
+};
+
+#endif //ZYX_RTSPSERVER_MEDIAREGISTRY_H
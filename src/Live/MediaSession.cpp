@@ -4,8 +4,22 @@
 #include <string.h>
 #include <algorithm>
 #include <assert.h>
+#include "../Scheduler/EventScheduler.h"
+#include "../Scheduler/Event.h"
 #include "../Base/Log.h"
 
+static_assert(SINK_GOP_CACHE_MAX_BYTES < TCP_DEFAULT_HIGH_WATER_MARK,
+              "gop cache replay must fit below the tcp high water mark");
+
+// 投递到连接所属事件循环的发送任务
+struct SendRtpPacketListTask
+{
+    MediaSession* mSession;
+    void* mTrack;
+    RtpPacketListPtr mPacketList;
+    EventScheduler* mScheduler;
+};
+
 
 MediaSession* MediaSession::createNew(std::string sessionName)
 {
@@ -54,8 +68,11 @@ MediaSession::~MediaSession()
     for (int i = 0; i < MEDIA_MAX_TRACK_NUM; ++i)
     {
         if (mTracks[i].mIsAlive) {
+            // Sink可能被多个MediaSession共享，最后一个引用者负责释放
             Sink* sink = mTracks[i].mSink;
-            delete sink;
+            sink->removeSessionCb(this, &mTracks[i]);
+            if (!sink->hasSessionCb())
+                delete sink;
         }
     }
 
@@ -135,7 +152,7 @@ bool MediaSession::addSink(MediaSession::TrackId trackId, Sink* sink)
     track->mSink = sink;
     track->mIsAlive = true;
 
-    sink->setSessionCb(MediaSession::sendPacketCallback,this, track);
+    sink->addSessionCb(MediaSession::sendPacketCallback,this, track);
     return true;
 }
 
@@ -145,6 +162,7 @@ bool MediaSession::addRtpInstance(MediaSession::TrackId trackId, RtpInstance* rt
     if(!track || track->mIsAlive != true)
         return false;
     
+    std::lock_guard <std::mutex> lck(mMtx);
     track->mRtpInstances.push_back(rtpInstance);
 
     return true;
@@ -152,6 +170,7 @@ bool MediaSession::addRtpInstance(MediaSession::TrackId trackId, RtpInstance* rt
 
 bool MediaSession::removeRtpInstance(RtpInstance* rtpInstance)
 {
+    std::lock_guard <std::mutex> lck(mMtx);
     for (int i = 0; i < MEDIA_MAX_TRACK_NUM; ++i)
     {
         if (mTracks[i].mIsAlive == false)
@@ -164,36 +183,214 @@ bool MediaSession::removeRtpInstance(RtpInstance* rtpInstance)
             continue;
 
         mTracks[i].mRtpInstances.erase(it);
+
+        // 回放未完成时取消定时器，移除发生在实例所属的事件循环中
+        for (std::list<GopReplay*>::iterator rit = mGopReplays.begin(); rit != mGopReplays.end(); ++rit) {
+            GopReplay* replay = *rit;
+            if (replay->mRtpInstance != rtpInstance)
+                continue;
+
+            rtpInstance->scheduler()->removeTimedEvent(replay->mTimerId);
+            mGopReplays.erase(rit);
+            delete replay->mTimerEvent;
+            delete replay;
+            break;
+        }
         return true;
     }
 
     return false;
 }
 
-void MediaSession::sendPacketCallback(void* arg1, void* arg2, void* packet, Sink::PacketType packetType)
+bool MediaSession::playRtpInstance(RtpInstance* rtpInstance)
+{
+    GopReplay* replay = NULL;
+    {
+        std::lock_guard <std::mutex> lck(mMtx);
+        for (int i = 0; i < MEDIA_MAX_TRACK_NUM && !replay; ++i)
+        {
+            if (mTracks[i].mIsAlive == false)
+                continue;
+
+            if (std::find(mTracks[i].mRtpInstances.begin(), mTracks[i].mRtpInstances.end(),
+                          rtpInstance) == mTracks[i].mRtpInstances.end())
+                continue;
+
+            if (!rtpInstance->scheduler()) {
+                rtpInstance->setAlive(true);
+                return true;
+            }
+
+            replay = new GopReplay;
+            replay->mSession = this;
+            replay->mTrack = &mTracks[i];
+            replay->mRtpInstance = rtpInstance;
+            replay->mTimerEvent = TimerEvent::createNew(replay);
+            replay->mTimerEvent->setTimeoutCallback(cbGopReplayTimeout);
+            replay->mTimerId = 0;
+            replay->mFrameNum = 0;
+            mGopReplays.push_back(replay);
+        }
+    }
+
+    if (!replay)
+        return false;
+
+    // 缓存为空时立即开始接收实时数据，定时器从未添加，可以直接释放
+    if (handleGopReplay(replay)) {
+        delete replay->mTimerEvent;
+        delete replay;
+    }
+    return true;
+}
+
+void MediaSession::cbGopReplayTimeout(void* arg)
+{
+    GopReplay* replay = (GopReplay*)arg;
+    if (replay->mSession->handleGopReplay(replay)) {
+        // 正在mTimerEvent的回调中，下一轮循环再释放
+        replay->mRtpInstance->scheduler()->queueInLoop(cbDeleteGopReplay, replay);
+    }
+}
+
+void MediaSession::cbDeleteGopReplay(void* arg)
+{
+    GopReplay* replay = (GopReplay*)arg;
+    delete replay->mTimerEvent;
+    delete replay;
+}
+
+bool MediaSession::handleGopReplay(GopReplay* replay)
 {
-    RtpPacket* rtpPacket = (RtpPacket*)packet;
+    RtpInstance* rtpInstance = replay->mRtpInstance;
+    std::vector<RtpPacketListPtr> packetLists;
+    int bytes = 0;
+
+    for (;;) {
+        size_t next = 0;
+        {
+            std::lock_guard <std::mutex> lck(mMtx);
+            replay->mTrack->mSink->getGopCache(packetLists);
+            while (next < packetLists.size() && packetLists[next]->frameIndex() <= rtpInstance->lastFrameIndex())
+                ++next;
+
+            if (next == packetLists.size()) {
+                // 已追上缓存：持有锁期间Sink的实时帧不会分发到本会话，之后缓存的帧都会实时发送，不会漏帧
+                rtpInstance->setAlive(true);
+                mGopReplays.remove(replay);
+                if (replay->mFrameNum > 0)
+                    LOGI("replay gop cache,frames=%d", replay->mFrameNum);
+                return true;
+            }
+        }
 
+        // 回放期间新缓存的帧也在这里补发；实例只在本事件循环中释放，不持锁发送
+        for (; next < packetLists.size(); ++next) {
+            if (bytes >= MEDIA_GOP_REPLAY_CHUNK_BYTES) {
+                replay->mTimerId = rtpInstance->scheduler()->addTimedEventRunAfater(replay->mTimerEvent,
+                                                                                    MEDIA_GOP_REPLAY_INTERVAL_MS);
+                return false;
+            }
+
+            rtpInstance->send(packetLists[next]);
+            bytes += packetLists[next]->size();
+            ++replay->mFrameNum;
+        }
+    }
+}
+
+void MediaSession::sendPacketCallback(void* arg1, void* arg2, void* packet, Sink::PacketType packetType)
+{
     MediaSession* session = (MediaSession*)arg1;
     MediaSession::Track* track = (MediaSession::Track*)arg2;
-    
-    session->handleSendRtpPacket(track, rtpPacket);
+
+    if (packetType == Sink::RTPPACKETLIST) {
+        session->handleSendRtpPacketList(track, *(RtpPacketListPtr*)packet);
+    }
+    else {
+        session->handleSendRtpPacket(track, (RtpPacket*)packet);
+    }
 }
 
 void MediaSession::handleSendRtpPacket(MediaSession::Track* track, RtpPacket* rtpPacket)
 {
 //    LOGI("");
 
+    // 单个RtpPacket由Sink复用，不能被引用或修改，拷贝成只读的包列表后走同一发送路径
+    RtpPacketListPtr packetList = std::make_shared<RtpPacketList>(RtpPacketList::packetSpace(rtpPacket->mSize));
+    RtpHeader* rtpHeader = packetList->addPacket(rtpPacket->mSize);
+    memcpy(rtpHeader, rtpPacket->mBuf4, rtpPacket->mSize);
+
+    handleSendRtpPacketList(track, packetList);
+}
+
+void MediaSession::handleSendRtpPacketList(MediaSession::Track* track, const RtpPacketListPtr& packetList)
+{
     std::list<RtpInstance*>::iterator it;
+    std::vector<EventScheduler*> schedulers;// 需要投递发送任务的其他事件循环
+    std::vector<RtpInstance*> rtpInstances;// 属于当前线程的实例，解锁后直接发送
 
-    for(it = track->mRtpInstances.begin(); it != track->mRtpInstances.end(); ++it){
-        RtpInstance* rtpInstance = *it;
-        if (rtpInstance->alive()){
-            rtpInstance->send(rtpPacket);
+    {
+        // 持锁只决定发往哪些事件循环，udp和tcp的发送都在各自的事件循环中进行，多个工作线程并行发送
+        std::lock_guard <std::mutex> lck(mMtx);
+        for(it = track->mRtpInstances.begin(); it != track->mRtpInstances.end(); ++it){
+            RtpInstance* rtpInstance = *it;
+            if (!rtpInstance->alive())
+                continue;
+
+            EventScheduler* scheduler = rtpInstance->scheduler();
+            if (!scheduler || scheduler->isInLoopThread()) {
+                rtpInstances.push_back(rtpInstance);
+            }
+            else if (std::find(schedulers.begin(), schedulers.end(), scheduler) == schedulers.end()) {
+                schedulers.push_back(scheduler);
+            }
         }
     }
+
+    // 这些实例只会在当前线程中被移除和释放（多播实例随会话释放），不持锁发送
+    for (size_t i = 0; i < rtpInstances.size(); ++i)
+        rtpInstances[i]->send(packetList);
+
+    // 每个事件循环每帧只投递一个任务，任务中只持有包列表的引用
+    for (size_t i = 0; i < schedulers.size(); ++i) {
+        SendRtpPacketListTask* task = new SendRtpPacketListTask;
+        task->mSession = this;
+        task->mTrack = track;
+        task->mPacketList = packetList;
+        task->mScheduler = schedulers[i];
+        schedulers[i]->queueInLoop(cbSendRtpPacketListInLoop, task);
+    }
 }
 
+void MediaSession::cbSendRtpPacketListInLoop(void* arg)
+{
+    SendRtpPacketListTask* task = (SendRtpPacketListTask*)arg;
+    task->mSession->handleSendRtpPacketListInLoop((MediaSession::Track*)task->mTrack,
+                                                  task->mPacketList, task->mScheduler);
+    delete task;
+}
+
+void MediaSession::handleSendRtpPacketListInLoop(MediaSession::Track* track, const RtpPacketListPtr& packetList,
+                                                 EventScheduler* scheduler)
+{
+    std::list<RtpInstance*>::iterator it;
+    std::vector<RtpInstance*> rtpInstances;
+
+    // 投递之后连接可能已断开，RtpInstance在释放前会先从session中移除，因此这里重新查找
+    {
+        std::lock_guard <std::mutex> lck(mMtx);
+        for(it = track->mRtpInstances.begin(); it != track->mRtpInstances.end(); ++it){
+            RtpInstance* rtpInstance = *it;
+            if (rtpInstance->alive() && rtpInstance->scheduler() == scheduler)
+                rtpInstances.push_back(rtpInstance);
+        }
+    }
+
+    // 这些实例只会在本事件循环中被移除和释放，解锁后发送不会访问到已释放的实例
+    for (size_t i = 0; i < rtpInstances.size(); ++i)
+        rtpInstances[i]->send(packetList);
+}
 
 bool MediaSession::startMulticast()
 {
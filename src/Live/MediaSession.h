@@ -2,11 +2,18 @@
 #define ZYX_RTSPSERVER_MEDIASESSION_H
 #include <string>
 #include <list>
+#include <mutex>
 
 #include "RtpInstance.h"
 #include "Sink.h"
+#include "../Scheduler/Timer.h"
+
+class EventScheduler;
+class TimerEvent;
 
 #define MEDIA_MAX_TRACK_NUM 2
+#define MEDIA_GOP_REPLAY_CHUNK_BYTES (64 * 1024) // GOPطʱÿ෢͵ֽ
+#define MEDIA_GOP_REPLAY_INTERVAL_MS 5           // طη͵ļԼ100Mbit/sһudpͻtcpͶ
 
 class MediaSession
 {
@@ -30,6 +37,8 @@ public:
 
     bool addRtpInstance(MediaSession::TrackId trackId, RtpInstance* rtpInstance);// 
     bool removeRtpInstance(RtpInstance* rtpInstance);// ɾ
+    // PLAYʱãRtpInstance¼ѭеãֶηSinkGOP棬׷Ϻٿʼʵʱ
+    bool playRtpInstance(RtpInstance* rtpInstance);
 
 
     bool startMulticast();
@@ -50,6 +59,25 @@ private:
    
     static void sendPacketCallback(void* arg1, void* arg2, void* packet,Sink::PacketType packetType);
     void handleSendRtpPacket(MediaSession::Track* tarck, RtpPacket* rtpPacket);
+    void handleSendRtpPacketList(MediaSession::Track* track, const RtpPacketListPtr& packetList);
+    // RtpInstanceudptcpֻ¼ѭзͣ¼ѭͶִʱٲRtpInstance
+    static void cbSendRtpPacketListInLoop(void* arg);
+    void handleSendRtpPacketListInLoop(MediaSession::Track* track, const RtpPacketListPtr& packetList,
+                                       EventScheduler* scheduler);
+
+    // ڽеGOPطţֻRtpInstance¼ѭз
+    struct GopReplay
+    {
+        MediaSession* mSession;
+        Track* mTrack;
+        RtpInstance* mRtpInstance;
+        TimerEvent* mTimerEvent;
+        Timer::TimerId mTimerId;
+        int mFrameNum;// ѻطŵ֡
+    };
+    static void cbGopReplayTimeout(void* arg);
+    static void cbDeleteGopReplay(void* arg);
+    bool handleGopReplay(GopReplay* replay);// һ飬׷ϻʱʼʵʱݲtrue
 
 
 
@@ -61,5 +89,9 @@ private:
     std::string mMulticastAddr;
     RtpInstance* mMulticastRtpInstances[MEDIA_MAX_TRACK_NUM];
     RtcpInstance* mMulticastRtcpInstances[MEDIA_MAX_TRACK_NUM];
+    std::list<GopReplay*> mGopReplays;// mMtx
+
+    // TrackmRtpInstancesReactorģʽڹ߳ɾRtpInstanceý嶨ʱ߳
+    std::mutex mMtx;
 };
 #endif //ZYX_RTSPSERVER_MEDIASESSION_H
\ No newline at end of file
@@ -1,44 +1,61 @@
 #include "MediaSource.h"
 #include "../Base/Log.h"
-MediaSource::MediaSource(UsageEnvironment* env) :
-    mEnv(env),mFps(0)
+MediaSource::MediaSource(UsageEnvironment* env, int frameNum) :
+    mEnv(env),
+    mFrames(new MediaFrame[frameNum]),
+    mFrameNum(frameNum),
+    mWriteCount(0),
+    mReadCount(0),
+    mReleaseCount(0),
+    mStrand(env->threadPool(), taskCallback, this),
+    mFps(0)
 {
-
-    for(int i = 0; i < DEFAULT_FRAME_NUM; ++i){
-        mFrameInputQueue.push(&mFrames[i]);
-    }
-    
-    mTask.setTaskCallback(taskCallback, this);
 }
 
 MediaSource::~MediaSource()
 {
     LOGI("~MediaSource()");
+    delete[] mFrames;
 }
 
 MediaFrame* MediaSource::getFrameFromOutputQueue() {
 
-    std::lock_guard <std::mutex> lck(mMtx);
-    if(mFrameOutputQueue.empty()){
+    if (mReadCount == mWriteCount.load(std::memory_order_acquire)) {
         return NULL;
     }
-    MediaFrame* frame = mFrameOutputQueue.front();
-    mFrameOutputQueue.pop();
+    MediaFrame* frame = &mFrames[mReadCount % mFrameNum];
+    ++mReadCount;
 
     return frame;
 }
 
 void MediaSource::putFrameToInputQueue(MediaFrame *frame) {
 
-    std::lock_guard <std::mutex> lck(mMtx);
+    uint64_t release = mReleaseCount.load(std::memory_order_relaxed);
+    if (frame != &mFrames[release % mFrameNum]) {
+        LOGE("frame returned out of order");
+        return;
+    }
+    mReleaseCount.store(release + 1, std::memory_order_release);
 
-    mFrameInputQueue.push(frame);
-    
-    mEnv->threadPool()->addTask(mTask);
+    requestFrames();
 }
 
+void MediaSource::requestFrames() {
+    mStrand.post();
+}
 
 void MediaSource::taskCallback(void* arg){
     MediaSource* source = (MediaSource*)arg;
     source->handleTask();
 }
+
+// 填满所有空闲槽位；执行期间Sink归还的帧由Strand安排再执行一次
+void MediaSource::handleTask(){
+    uint64_t write = mWriteCount.load(std::memory_order_relaxed);
+    while (write - mReleaseCount.load(std::memory_order_acquire) < (uint64_t)mFrameNum) {
+        if (!readFrame(&mFrames[write % mFrameNum]))
+            return;
+        mWriteCount.store(++write, std::memory_order_release);
+    }
+}
@@ -1,62 +1,77 @@
 ﻿#ifndef ZYX_RTSPSERVER_MEDIASOURCE_H
 #define ZYX_RTSPSERVER_MEDIASOURCE_H
-#include <queue>
+#include <vector>
 #include <mutex>
+#include <atomic>
 #include <stdint.h>
 #include "../Scheduler/UsageEnvironment.h"
 #include "../Scheduler/ThreadPool.h"
+#include "../Scheduler/Strand.h"
 
 
-#define FRAME_MAX_SIZE (1024*200)
-#define DEFAULT_FRAME_NUM 4
+#define DEFAULT_FRAME_NUM 4 // 默认的帧环形队列深度
 
 class MediaFrame
 {
 
 public:
+    struct Nalu
+    {
+        uint8_t* mBuf;// 不含起始码
+        int mSize;
+    };
+
     MediaFrame() :
-        temp(new uint8_t[FRAME_MAX_SIZE]),
         mBuf(nullptr),
         mSize(0){
         
     }
-    ~MediaFrame(){
-        delete []temp;
-    }
-    
-    uint8_t* temp;// 容器
-    uint8_t* mBuf;// 引用容器
+
+    // 所有MediaSource都直接引用映射内存中的帧数据，帧本身不持有缓冲区
+    uint8_t* mBuf;// 引用映射内存
     int mSize;
+    std::vector<Nalu> mNalus;// 视频：一个访问单元（一幅图像）的所有nalu，共用一个时间戳
 };
 
+/*
+    帧环形队列：mFrameNum个帧槽位按顺序循环使用，每个槽位依次经历 空闲 -> 已填充 -> 发送中 -> 空闲。
+    生产者为线程池中的读取任务（通过Strand串行执行，同一时刻只有一个在运行），只推进mWriteCount；
+    消费者为Sink所在的loop线程，只推进mReadCount和mReleaseCount。两边都不加锁，loop线程不会等待文件读取。
+*/
 class MediaSource
 {
 
 public:
 
-    explicit MediaSource(UsageEnvironment* env);
+    // frameNum：帧环形队列深度，即最多预读多少帧
+    explicit MediaSource(UsageEnvironment* env, int frameNum = DEFAULT_FRAME_NUM);
     virtual ~MediaSource();
 
-    MediaFrame* getFrameFromOutputQueue();//从输出队列获取帧
-    void putFrameToInputQueue(MediaFrame* frame); // 把帧送入输入队列
+    MediaFrame* getFrameFromOutputQueue();//从输出队列获取帧，只能由Sink的loop线程调用
+    void putFrameToInputQueue(MediaFrame* frame); // 把帧送入输入队列，必须按取出的顺序归还
     int getFps() const { return mFps; }
     std::string getSourceName(){ return mSourceName;}
 
 private:
     static void taskCallback(void* arg);
+    void handleTask();
 protected:
-    virtual void handleTask() = 0;
+    // 在线程池中调用，同一时刻只有一个线程调用；把下一帧填入frame，没有数据时返回false
+    virtual bool readFrame(MediaFrame* frame) = 0;
+    void requestFrames();// 有空闲槽位时投递读取任务，子类构造完成后调用一次开始预读
     void setFps(int fps) { mFps = fps; }
 
 protected:
     UsageEnvironment* mEnv;
-    MediaFrame mFrames[DEFAULT_FRAME_NUM];
-    std::queue<MediaFrame*> mFrameInputQueue;
-    std::queue<MediaFrame*> mFrameOutputQueue;
+    MediaFrame* mFrames;
+    int mFrameNum;
+    std::atomic<uint64_t> mWriteCount;// 已填充的帧数
+    uint64_t mReadCount;// 已被Sink取出的帧数
+    std::atomic<uint64_t> mReleaseCount;// 已被Sink归还的帧数
 
 
-    std::mutex mMtx;
-    ThreadPool::Task mTask;
+    std::mutex mMtx;// 子类读取位置的锁（readFrame与seek之间），Sink不使用
+    Strand mStrand;// 读取任务，Sink频繁归还帧也不会重复排队
     int mFps;
     std::string mSourceName;
 
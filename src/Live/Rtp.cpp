@@ -13,6 +13,31 @@ RtpPacket::~RtpPacket() {
     free(mBuf);
     mBuf = NULL;
 }
+RtpPacketList::RtpPacketList(int capacity) :
+    mBuf((uint8_t*)malloc(capacity)),
+    mCapacity(capacity),
+    mUsed(0),
+    mKeyFrame(false),
+    mReference(true),
+    mFrameIndex(0) {
+}
+RtpPacketList::~RtpPacketList() {
+    free(mBuf);
+    mBuf = NULL;
+}
+RtpHeader* RtpPacketList::addPacket(int size) {
+    int space = packetSpace(size);
+    if (mUsed + space > mCapacity)
+        return NULL;
+
+    Packet packet;
+    packet.mBuf = mBuf + mUsed;
+    packet.mSize = size;
+    mPackets.push_back(packet);
+
+    mUsed += space;
+    return (RtpHeader*)packet.mBuf;
+}
 void parseRtpHeader(uint8_t* buf, struct RtpHeader* rtpHeader)
 {
     memset(rtpHeader, 0, sizeof(*rtpHeader));
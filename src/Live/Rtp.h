@@ -2,14 +2,18 @@
 #define ZYX_RTSPSERVER_RTP_H
 #include <stdint.h>
 #include <stdlib.h>
+#include <vector>
+#include <memory>
 
 #define RTP_VESION              2
 
 #define RTP_PAYLOAD_TYPE_H264   96
 #define RTP_PAYLOAD_TYPE_AAC    97
+#define RTP_PAYLOAD_TYPE_H265   98
 
 #define RTP_HEADER_SIZE         12
 #define RTP_MAX_PKT_SIZE        1400
+#define RTP_TCP_HEADER_SIZE     4 // RTP over TCP的interleaved头：'$' + channel + 2字节长度
 
 struct RtpHeader{
     // byte 0
@@ -57,6 +61,55 @@ public:
     int mSize;// rtpHeader+rtpBody
 };
 
+/*
+    一帧封好的RTP包列表：所有包放在一次分配的连续内存中，每个包按4字节对齐。
+    RTP over TCP的interleaved头由TcpConnection在发送时单独生成，包中不预留空间。
+    封包完成后不再修改，通过RtpPacketListPtr在所有订阅的会话和RtpInstance之间共享，
+    发送慢的连接只需持有引用，不需要拷贝。
+*/
+class RtpPacketList {
+public:
+    struct Packet {
+        uint8_t* mBuf;// rtpHeader+rtpBody
+        int mSize;// rtpHeader+rtpBody
+    };
+
+    explicit RtpPacketList(int capacity);
+    ~RtpPacketList();
+
+    // 一个大小为size(rtpHeader+rtpBody)的包在列表中占用的空间，按4字节对齐
+    static int packetSpace(int size) { return (size + 3) & ~3; }
+
+    RtpHeader* addPacket(int size);// 追加一个包，返回其rtpHeader，空间不足时返回NULL
+
+    // 供TCP发送队列的丢帧策略使用：关键帧（IDR及参数集、音频帧）可作为恢复点，非参考帧可优先丢弃
+    void setFrameType(bool keyFrame, bool reference) { mKeyFrame = keyFrame; mReference = reference; }
+    bool isKeyFrame() const { return mKeyFrame; }
+    bool isReference() const { return mReference; }
+
+    // Sink分发前按帧顺序编号（从1开始），0表示未编号；GOP缓存回放时据此去掉重复的帧
+    void setFrameIndex(uint64_t frameIndex) { mFrameIndex = frameIndex; }
+    uint64_t frameIndex() const { return mFrameIndex; }
+    int size() const { return mUsed; }// 占用的字节数
+
+    int packetNum() const { return (int)mPackets.size(); }
+    const Packet& packet(int i) const { return mPackets[i]; }
+
+private:
+    RtpPacketList(const RtpPacketList&);
+    RtpPacketList& operator=(const RtpPacketList&);
+
+private:
+    uint8_t* mBuf;
+    int mCapacity;
+    int mUsed;
+    std::vector<Packet> mPackets;
+    bool mKeyFrame;
+    bool mReference;
+    uint64_t mFrameIndex;
+};
+typedef std::shared_ptr<RtpPacketList> RtpPacketListPtr;
+
 void parseRtpHeader(uint8_t* buf, struct RtpHeader* rtpHeader);
 void parseRtcpHeader(uint8_t* buf, struct RtcpHeader* rtcpHeader);
 
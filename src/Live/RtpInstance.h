@@ -1,13 +1,20 @@
 ﻿#ifndef ZYX_RTSPSERVER_RTPINSTANNCE_H
 #define ZYX_RTSPSERVER_RTPINSTANNCE_H
 #include <string>
+#include <vector>
 #include <stdint.h>
+#include <errno.h>
 #ifndef WIN32
 #include <unistd.h>
 #endif // !WIN32
 #include "InetAddress.h"
 #include "../Scheduler/SocketsOps.h"
 #include "Rtp.h"
+#include "TcpConnection.h"
+#include "../Base/Log.h"
+
+#define RTP_GSO_MAX_SEGMENT_NUM 64      // 内核单次GSO发送的最大分段数
+#define RTP_GSO_MAX_BYTES       65000   // 单次GSO发送的最大字节数（不超过一个UDP数据报）
 
 
 class RtpInstance
@@ -19,48 +26,64 @@ public:
         RTP_OVER_TCP
     };
 
+    // scheduler为拥有该实例的事件循环，发送任务投递到该循环执行；为NULL时（如多播）由媒体定时器所在线程直接发送
     static RtpInstance* createNewOverUdp(int localSockfd, uint16_t localPort,
-                                         std::string destIp, uint16_t destPort)
+                                         std::string destIp, uint16_t destPort,
+                                         EventScheduler* scheduler = NULL)
     {
-        return new RtpInstance(localSockfd, localPort, destIp, destPort);
+        return new RtpInstance(localSockfd, localPort, destIp, destPort, scheduler);
     }
 
-    static RtpInstance* createNewOverTcp(int sockfd, uint8_t rtpChannel)
+    static RtpInstance* createNewOverTcp(TcpConnection* tcpConnection, int sockfd, uint8_t rtpChannel)
     {
-        return new RtpInstance(sockfd, rtpChannel);
+        return new RtpInstance(tcpConnection, sockfd, rtpChannel);
     }
 
     ~RtpInstance()
     {
-        sockets::close(mSockfd);
+        // over tcp时复用的是rtsp连接的描述符，由TcpConnection负责关闭
+        if (mRtpType == RTP_OVER_UDP)
+            sockets::close(mSockfd);
     }
     uint16_t getLocalPort() const { return mLocalPort; }
     uint16_t getPeerPort() { return mDestAddr.getPort(); }
 
-    int send(RtpPacket* rtpPacket)
+    // 发送共享的只读包列表，不修改其中的任何数据
+    // 必须在scheduler()所属的事件循环中调用（scheduler()为NULL时在媒体定时器所在线程调用）
+    int send(const RtpPacketListPtr& packetList)
     {
+        // GOP缓存回放过的帧不再重复发送
+        uint64_t frameIndex = packetList->frameIndex();
+        if (frameIndex != 0) {
+            if (frameIndex <= mLastFrameIndex)
+                return 0;
+            mLastFrameIndex = frameIndex;
+        }
+
         switch (mRtpType)
         {
             case RtpInstance::RTP_OVER_UDP: {
-                return sendOverUdp(rtpPacket->mBuf4, rtpPacket->mSize);
-                break;
+                return sendListOverUdp(*packetList);
             }
             case RtpInstance::RTP_OVER_TCP: {
-                rtpPacket->mBuf[0] = '$';
-                rtpPacket->mBuf[1] = (uint8_t)mRtpChannel;
-                rtpPacket->mBuf[2] = (uint8_t)(((rtpPacket->mSize) & 0xFF00) >> 8);
-                rtpPacket->mBuf[3] = (uint8_t)((rtpPacket->mSize) & 0xFF);
-                return sendOverTcp(rtpPacket->mBuf, 4 + rtpPacket->mSize);
-                break;
+                mTcpConnection->sendPacketList(packetList, mRtpChannel);
+                return 0;
             }
 
             default: {
                 return -1;
-                break;
             }
         }
     }
 
+    bool isOverTcp() const { return mRtpType == RTP_OVER_TCP; }
+    TcpConnection* tcpConnection() const { return mTcpConnection; }
+    EventScheduler* scheduler() const { return mScheduler; }
+    uint64_t lastFrameIndex() const { return mLastFrameIndex; }
+
+    // 开启后UDP发送时尽量使用GSO，一次把一帧中等长的FU-A分片交给内核切分；不支持时自动回退
+    void setGso(bool on) { mUseGso = on; }
+
     bool alive() const { return mIsAlive; }
     int setAlive(bool alive) { mIsAlive = alive; return 0; };
     void setSessionId(uint16_t sessionId) { mSessionId = sessionId; }
@@ -68,31 +91,92 @@ public:
 
 
 private:
-    int sendOverUdp(void * buf, int size)
+    // 一帧的所有包通过sendmmsg批量发送，每个客户端每帧通常只需一次系统调用
+    int sendListOverUdp(const RtpPacketList& packetList)
     {
-        return sockets::sendto(mSockfd, buf, size, mDestAddr.getAddr());
+        int num = packetList.packetNum();
+        mIovecs.resize(num);
+        for (int i = 0; i < num; ++i) {
+            mIovecs[i].iov_base = packetList.packet(i).mBuf;
+            mIovecs[i].iov_len = packetList.packet(i).mSize;
+        }
+
+        if (mUseGso)
+            return sendListOverUdpGso(num);
+
+        return sockets::sendmmsg(mSockfd, mIovecs.data(), num, mDestAddr.getAddr());
     }
 
-    int sendOverTcp(void * buf, int size)
+    // 连续且长度相同的包（最后一个可以更短）合成一次GSO发送，其余的包走sendmmsg
+    int sendListOverUdpGso(int num)
     {
-        return sockets::write(mSockfd, buf, size);
+        int sent = 0;
+        int i = 0;
+        while (i < num) {
+            size_t segSize = mIovecs[i].iov_len;
+            int maxSeg = RTP_GSO_MAX_BYTES / (int)segSize;
+            if (maxSeg > RTP_GSO_MAX_SEGMENT_NUM)
+                maxSeg = RTP_GSO_MAX_SEGMENT_NUM;
+
+            int segNum = 1;
+            while (i + segNum < num && segNum < maxSeg) {
+                size_t len = mIovecs[i + segNum].iov_len;
+                if (len > segSize)
+                    break;
+                ++segNum;
+                if (len < segSize)// 更短的包只能作为最后一个分段
+                    break;
+            }
+
+            int ret;
+            if (segNum > 1)
+                ret = sockets::sendGso(mSockfd, &mIovecs[i], segNum, (uint16_t)segSize, mDestAddr.getAddr());
+            else
+                ret = sockets::sendmmsg(mSockfd, &mIovecs[i], 1, mDestAddr.getAddr());
+
+            if (ret < 0) {
+                if (ret == -EIO || ret == -EINVAL || ret == -ENOPROTOOPT || ret == -EOPNOTSUPP) {
+                    // 内核或网卡不支持UDP_SEGMENT，关闭GSO并改用逐包发送
+                    LOGI("udp gso unsupported,fallback to sendmmsg,fd=%d,errno=%d", mSockfd, -ret);
+                    mUseGso = false;
+                    return sent + sockets::sendmmsg(mSockfd, &mIovecs[i], num - i, mDestAddr.getAddr());
+                }
+
+                // EAGAIN/ENOBUFS等临时错误：与sendmmsg一样丢弃剩余的包，GSO保持开启
+                return sent;
+            }
+
+            sent += ret;
+            i += segNum;
+        }
+
+        return sent;
     }
 
 public:
-    RtpInstance(int localSockfd, uint16_t localPort, const std::string& destIp, uint16_t destPort) :
+    RtpInstance(int localSockfd, uint16_t localPort, const std::string& destIp, uint16_t destPort,
+                EventScheduler* scheduler) :
         mRtpType(RTP_OVER_UDP), 
         mSockfd(localSockfd), mLocalPort(localPort),mDestAddr(destIp, destPort), 
         mIsAlive(false), 
         mSessionId(0),
-        mRtpChannel(0) {
+        mRtpChannel(0),
+        mTcpConnection(NULL),
+        mScheduler(scheduler),
+        mUseGso(false),
+        mLastFrameIndex(0) {
     }
 
-    RtpInstance(int sockfd, uint8_t rtpChannel) : 
+    RtpInstance(TcpConnection* tcpConnection, int sockfd, uint8_t rtpChannel) :
         mRtpType(RTP_OVER_TCP), 
         mSockfd(sockfd),mLocalPort(0),
         mIsAlive(false), 
         mSessionId(0),
-        mRtpChannel(rtpChannel){
+        mRtpChannel(rtpChannel),
+        mTcpConnection(tcpConnection),
+        mScheduler(tcpConnection->env()->scheduler()),
+        mUseGso(false),
+        mLastFrameIndex(0){
     }
 
 
@@ -104,6 +188,11 @@ private:
     bool mIsAlive;
     uint16_t mSessionId;
     uint8_t mRtpChannel;
+    TcpConnection* mTcpConnection; //for tcp，RTP数据通过该连接的发送队列发送
+    EventScheduler* mScheduler;// 拥有该实例的事件循环，所有发送都在其中执行
+    std::vector<struct iovec> mIovecs;// sendmmsg使用，避免每帧重新分配
+    bool mUseGso;
+    uint64_t mLastFrameIndex;// 最后发送的包列表编号
 };
 
 class RtcpInstance
@@ -39,20 +39,20 @@ RtspConnection::RtspConnection(RtspServer* rtspServer, int clientFd) :
         mRtcpInstances[i] = NULL;
     }
     getPeerIp(clientFd, mPeerIp);
+    setHighWaterMark(rtspServer->tcpHighWaterMark());
 
 }
 
 RtspConnection::~RtspConnection()
 {
     LOGI("~RtspConnection() mClientFd=%d", mClientFd);
+    MediaSession* session = mRtspServer->mSessMgr->getSession(mSessionName);
     for (int i = 0; i < MEDIA_MAX_TRACK_NUM; ++i)
     {
         if (mRtpInstances[i])
         {
-
-            MediaSession* session = mRtspServer->mSessMgr->getSession(mSuffix);
-
-            if (!session) {
+            // 先从session中移除，之后媒体发送线程不会再访问该RtpInstance
+            if (session) {
                 session->removeRtpInstance(mRtpInstances[i]);
             }
             delete mRtpInstances[i];
@@ -409,6 +409,7 @@ bool RtspConnection::handleCmdSetup(){
     if (mTrackId >= MEDIA_MAX_TRACK_NUM || mRtpInstances[mTrackId] || mRtcpInstances[mTrackId]) {
         return false;
     }
+    mSessionName = sessionName;
 
     if (session->isStartMulticast()) {
         snprintf((char*)mBuffer, sizeof(mBuffer),
@@ -501,10 +502,14 @@ bool RtspConnection::handleCmdPlay()
     if (sendMessage(mBuffer, strlen(mBuffer)) < 0)
         return false;
 
+    MediaSession* session = mRtspServer->mSessMgr->getSession(mSessionName);
+
     for (int i = 0; i < MEDIA_MAX_TRACK_NUM; ++i)
     {
         if (mRtpInstances[i]) {
-            mRtpInstances[i]->setAlive(true);
+            // 先回放GOP缓存，客户端立即从最近的关键帧开始解码
+            if (!session || !session->playRtpInstance(mRtpInstances[i]))
+                mRtpInstances[i]->setAlive(true);
         }
          
         if (mRtcpInstances[i]) {
@@ -536,20 +541,14 @@ bool RtspConnection::handleCmdTeardown()
 int RtspConnection::sendMessage(void* buf, int size)
 {
     LOGI("%s", buf);
-    int ret;
-
-    mOutBuffer.append(buf, size);
-    ret = mOutBuffer.write(mClientFd);
-    mOutBuffer.retrieveAll();
 
-    return ret;
+    // 进入发送队列，写不完的部分等待可写事件继续发送，不再丢弃
+    return send(buf, size);
 }
 
 int RtspConnection::sendMessage()
 {
-    int ret = mOutBuffer.write(mClientFd);
-    mOutBuffer.retrieveAll();
-    return ret;
+    return flushOutQueue() ? 0 : -1;
 }
 
 bool RtspConnection::createRtpRtcpOverUdp(MediaSession::TrackId trackId, std::string peerIp,
@@ -607,7 +606,8 @@ bool RtspConnection::createRtpRtcpOverUdp(MediaSession::TrackId trackId, std::st
         return false;
 
     mRtpInstances[trackId] = RtpInstance::createNewOverUdp(rtpSockfd, rtpPort,
-                                                           peerIp, peerRtpPort);
+                                                           peerIp, peerRtpPort, env()->scheduler());
+    mRtpInstances[trackId]->setGso(mRtspServer->udpGso());
     mRtcpInstances[trackId] = RtcpInstance::createNew(rtcpSockfd, rtcpPort,
                                                       peerIp, peerRtcpPort);
 
@@ -617,7 +617,7 @@ bool RtspConnection::createRtpRtcpOverUdp(MediaSession::TrackId trackId, std::st
 bool RtspConnection::createRtpOverTcp(MediaSession::TrackId trackId, int sockfd,
                                       uint8_t rtpChannel)
 {
-    mRtpInstances[trackId] = RtpInstance::createNewOverTcp(sockfd, rtpChannel);
+    mRtpInstances[trackId] = RtpInstance::createNewOverTcp(this, sockfd, rtpChannel);
 
     return true;
 }
@@ -61,6 +61,7 @@ private:
     Method mMethod;
     std::string mUrl;
     std::string mSuffix;
+    std::string mSessionName;// setup成功后记录所属session，断开时从session中移除RtpInstance
     uint32_t mCSeq;
     std::string mStreamPrefix;// 数据流名称（作为拉流服务默认是track）
 
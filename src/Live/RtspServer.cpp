@@ -1,6 +1,8 @@
 ﻿#include "RtspServer.h"
 #include "RtspConnection.h"
+#include "../Scheduler/EventLoopThread.h"
 #include "../Base/Log.h"
+#include <thread>
 
 RtspServer* RtspServer::createNew(UsageEnvironment* env, MediaSessionManager* sessMgr, Ipv4Address& addr) {
 
@@ -9,25 +11,25 @@ RtspServer* RtspServer::createNew(UsageEnvironment* env, MediaSessionManager* se
 RtspServer::RtspServer(UsageEnvironment* env, MediaSessionManager* sessMgr, Ipv4Address& addr) :
         mSessMgr(sessMgr),
         mEnv(env),
+        mFd(-1),
         mAddr(addr),
-        mListen(false)
+        mListen(false),
+        mReusePort(false),
+        mBacklog(60),
+        mUdpGso(false),
+        mTcpHighWaterMark(TCP_DEFAULT_HIGH_WATER_MARK),
+        mAcceptIOEvent(NULL),
+        mWorkerNum(0),
+        mNextWorker(0),
+        mConnNum(0)
 {
 
-    mFd = sockets::createTcpSock();
-    sockets::setReuseAddr(mFd, 1);
-    if (!sockets::bind(mFd, addr.getIp(), mAddr.getPort())) {
-        return;
-    }
-
-    LOGI("rtsp://%s:%d fd=%d",addr.getIp().data(),addr.getPort(), mFd);
-
-    mAcceptIOEvent = IOEvent::createNew(mFd, this);
-    mAcceptIOEvent->setReadCallback(readCallback);//设置回调的socket可读 函数指针
-    mAcceptIOEvent->enableReadHandling();
-
     mCloseTriggerEvent = TriggerEvent::createNew(this);
     mCloseTriggerEvent->setTriggerCallback(cbCloseConnect);//设置回调的关闭连接 函数指针
 
+    mNewConnTriggerEvent = TriggerEvent::createNew(this);
+    mNewConnTriggerEvent->setTriggerCallback(cbNewConnect);//设置回调的创建连接 函数指针
+
 }
 
 RtspServer::~RtspServer()
@@ -35,23 +37,127 @@ RtspServer::~RtspServer()
     if (mListen)
         mEnv->scheduler()->removeIOEvent(mAcceptIOEvent);
 
+    // 先停止所有工作循环，再释放工作循环上的对象
+    for (size_t i = 0; i < mWorkerThreads.size(); ++i)
+        mWorkerThreads[i]->stopLoop();
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        delete mWorkers[i];
+        delete mWorkerEnvs[i];
+        delete mWorkerThreads[i];
+    }
+
     delete mAcceptIOEvent;
     delete mCloseTriggerEvent;
+    delete mNewConnTriggerEvent;
+
+    if (mFd >= 0)
+        sockets::close(mFd);
+}
+
+void RtspServer::setWorkerNum(int num)
+{
+    mWorkerNum = num > 0 ? num : 0;
+}
+
+void RtspServer::setReusePort(bool on)
+{
+    mReusePort = on;
+}
 
-    sockets::close(mFd);
+void RtspServer::setBacklog(int backlog)
+{
+    if (backlog > 0)
+        mBacklog = backlog;
 }
 
+void RtspServer::setUdpGso(bool on)
+{
+    mUdpGso = on;
+}
 
+void RtspServer::setTcpHighWaterMark(int bytes)
+{
+    if (bytes > 0)
+        mTcpHighWaterMark = bytes;
+}
 
-void RtspServer::start(){
+bool RtspServer::start(){
     LOGI("");
+
+    startWorkers();
+
+    // SO_REUSEPORT模式：每个工作循环各自持有监听描述符，内核在它们之间分配新连接，不再经过单一的accept线程
+    if (mReusePort && !mWorkers.empty()) {
+        int failed = 0;
+        for (size_t i = 0; i < mWorkers.size(); ++i) {
+            mWorkers[i]->mBacklog = mBacklog;
+            if (!mWorkers[i]->startListen(true)) {
+                LOGE("worker %d listen failed", (int)i);
+                ++failed;
+            }
+        }
+        return failed == 0;
+    }
+
+    return startListen(false);
+}
+
+bool RtspServer::startListen(bool reusePort) {
+
+    mFd = sockets::createTcpSock();
+    sockets::setReuseAddr(mFd, 1);
+    if (reusePort)
+        sockets::setReusePort(mFd);// 必须在bind之前设置
+    if (!sockets::bind(mFd, mAddr.getIp(), mAddr.getPort()) || !sockets::listen(mFd, mBacklog)) {
+        LOGE("rtsp://%s:%d bind or listen error,fd=%d", mAddr.getIp().data(), mAddr.getPort(), mFd);
+        sockets::close(mFd);
+        mFd = -1;
+        return false;
+    }
+
+    LOGI("rtsp://%s:%d fd=%d,backlog=%d", mAddr.getIp().data(), mAddr.getPort(), mFd, mBacklog);
+
+    // 监听成功后再创建IO事件，失败时无需释放
+    mAcceptIOEvent = IOEvent::createNew(mFd, this);
+    mAcceptIOEvent->setReadCallback(readCallback);//设置回调的socket可读 函数指针
+    mAcceptIOEvent->enableReadHandling();
     mListen = true;
-    sockets::listen(mFd, 60);
 
     // 将 mAcceptIOEvent 添加到事件调度器中，表示服务器将接受来自客户端的连接请求
+    // 工作循环的poller只能由其自身线程操作，因此投递到所属循环中注册
+    mEnv->scheduler()->runInLoop(cbListen, this);
+    return true;
+}
+
+void RtspServer::cbListen(void* arg) {
+    RtspServer* server = (RtspServer*)arg;
+    server->handleListen();
+}
+
+void RtspServer::handleListen() {
     mEnv->scheduler()->addIOEvent(mAcceptIOEvent);
 }
 
+// 每个工作循环运行在独立线程并绑定到一个CPU核，拥有自己的RtspServer来管理分配给它的连接
+void RtspServer::startWorkers() {
+    int cpuNum = (int)std::thread::hardware_concurrency();
+
+    for (int i = 0; i < mWorkerNum; ++i) {
+        int cpu = cpuNum > 0 ? i % cpuNum : -1;
+        EventLoopThread* thread = EventLoopThread::createNew(mEnv->scheduler()->pollerType(), cpu);
+        EventScheduler* scheduler = thread->startLoop();
+        UsageEnvironment* env = UsageEnvironment::createNew(scheduler, mEnv->threadPool());
+
+        mWorkerThreads.push_back(thread);
+        mWorkerEnvs.push_back(env);
+        RtspServer* worker = new RtspServer(env, mSessMgr, mAddr);
+        worker->mUdpGso = mUdpGso;
+        worker->mTcpHighWaterMark = mTcpHighWaterMark;
+        mWorkers.push_back(worker);
+    }
+    LOGI("workerNum=%d", mWorkerNum);
+}
+
 void RtspServer::readCallback(void  * arg) {
     RtspServer* rtspServer = (RtspServer*)arg;
     rtspServer->handleRead();
@@ -69,11 +175,66 @@ void RtspServer::handleRead() {
         LOGE("handleRead error,clientFd=%d",clientFd);
         return;
     }
+
+    if (mWorkers.empty()) {
+        ++mConnNum;
+        createConnection(clientFd);
+    }
+    else {
+        selectWorker()->addConnection(clientFd);
+    }
+
+}
+
+// 选择连接数最少的工作循环，连接数相同时按轮询顺序
+RtspServer* RtspServer::selectWorker() {
+    size_t num = mWorkers.size();
+    size_t best = mNextWorker % num;
+
+    for (size_t i = 1; i < num; ++i) {
+        size_t index = (mNextWorker + i) % num;
+        if (mWorkers[index]->mConnNum < mWorkers[best]->mConnNum)
+            best = index;
+    }
+    mNextWorker = best + 1;
+
+    return mWorkers[best];
+}
+
+void RtspServer::addConnection(int clientFd) {
+    {
+        std::lock_guard <std::mutex> lck(mMtx);
+        mNewConnList.push_back(clientFd);
+    }
+    ++mConnNum;
+
+    mEnv->scheduler()->addTriggerEvent(mNewConnTriggerEvent);
+}
+
+void RtspServer::cbNewConnect(void* arg) {
+    RtspServer* server = (RtspServer*)arg;
+    server->handleNewConnect();
+}
+
+// 在本对象所在的事件循环中创建连接，连接的IO事件从此只由该循环处理
+void RtspServer::handleNewConnect() {
+    std::vector<int> newConnList;
+    {
+        std::lock_guard <std::mutex> lck(mMtx);
+        newConnList.swap(mNewConnList);
+    }
+
+    for (std::vector<int>::iterator it = newConnList.begin(); it != newConnList.end(); ++it) {
+        createConnection(*it);
+    }
+}
+
+void RtspServer::createConnection(int clientFd) {
     RtspConnection* conn = RtspConnection::createNew(this, clientFd);
     conn->setDisConnectCallback(RtspServer::cbDisConnect, this);
     mConnMap.insert(std::make_pair(clientFd, conn));
-
 }
+
 void RtspServer::cbDisConnect(void* arg, int clientFd) {
     RtspServer* server = (RtspServer*)arg;
 
@@ -103,13 +264,15 @@ void RtspServer::handleCloseConnect() {
 
         int clientFd = *it;
         std::map<int, RtspConnection*>::iterator _it = mConnMap.find(clientFd);
-        assert(_it != mConnMap.end());
+        if (_it == mConnMap.end())// 同一连接可能多次上报断开
+            continue;
         delete _it->second;
         mConnMap.erase(clientFd);
+        --mConnNum;
     }
 
     mDisConnList.clear();
 
 
 
-}
\ No newline at end of file
+}
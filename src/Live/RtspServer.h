@@ -1,12 +1,15 @@
 ﻿#ifndef ZYX_RTSPSERVER_RTSPSERVER_H
 #define ZYX_RTSPSERVER_RTSPSERVER_H
+#include <map>
 #include <mutex>
+#include <atomic>
 #include "../Scheduler/UsageEnvironment.h"
 #include "../Scheduler/Event.h"
 #include "MediaSession.h"
 #include "InetAddress.h"
 class MediaSessionManager;
 class RtspConnection;
+class EventLoopThread;
 class RtspServer {
 
 public:
@@ -17,7 +20,14 @@ public:
 
 public:
     MediaSessionManager* mSessMgr;
-    void start();
+    void setWorkerNum(int num);// 在start()之前调用，num > 0 时开启多Reactor模式
+    void setReusePort(bool on);// 在start()之前调用，多Reactor模式下每个工作循环各自监听同一地址，由内核分配连接
+    void setBacklog(int backlog);// 在start()之前调用，listen的backlog
+    void setUdpGso(bool on);// 在start()之前调用，RTP over UDP时使用UDP GSO发送大帧
+    bool udpGso() const { return mUdpGso; }
+    void setTcpHighWaterMark(int bytes);// 在start()之前调用，RTP over TCP发送队列的高水位，超过后开始丢帧
+    int tcpHighWaterMark() const { return mTcpHighWaterMark; }
+    bool start();// 监听失败（多Reactor的SO_REUSEPORT模式下任一工作循环失败）时返回false
     UsageEnvironment* env() const {
         return mEnv;
     }
@@ -29,12 +39,26 @@ private:
     static void cbCloseConnect(void* arg);
     void handleCloseConnect();
 
+    bool startListen(bool reusePort);
+    static void cbListen(void* arg);
+    void handleListen();
+    void startWorkers();
+    RtspServer* selectWorker();
+    void addConnection(int clientFd);// 线程安全，把已accept的连接交给本对象所在的事件循环
+    static void cbNewConnect(void* arg);
+    void handleNewConnect();
+    void createConnection(int clientFd);
+
 private:
     
     UsageEnvironment* mEnv;
     int  mFd;
     Ipv4Address mAddr;
     bool mListen;
+    bool mReusePort;
+    int mBacklog;
+    bool mUdpGso;
+    int mTcpHighWaterMark;
     IOEvent* mAcceptIOEvent;
     std::mutex mMtx;
 
@@ -42,5 +66,15 @@ private:
     std::vector<int> mDisConnList;//所有被取消的连接 clientFd
     TriggerEvent* mCloseTriggerEvent;// 关闭连接的触发事件
 
+    // 多Reactor模式：主循环只负责accept，连接分发给各工作循环，由工作循环的RtspServer管理
+    int mWorkerNum;
+    std::vector<EventLoopThread*> mWorkerThreads;
+    std::vector<UsageEnvironment*> mWorkerEnvs;
+    std::vector<RtspServer*> mWorkers;
+    size_t mNextWorker;// 轮询起点
+    std::atomic<int> mConnNum;// 本对象管理的连接数，用于选择负载最小的工作循环
+    std::vector<int> mNewConnList;// 待本事件循环创建的连接 clientFd
+    TriggerEvent* mNewConnTriggerEvent;// 创建连接的触发事件
+
 };
 #endif //ZYX_RTSPSERVER_RTSPSERVER_H
@@ -1,11 +1,13 @@
 ﻿#include "Sink.h"
+#include "MediaRegistry.h"
 #include "../Scheduler/SocketsOps.h"
 #include "../Base/Log.h"
 
 
 Sink::Sink(UsageEnvironment* env, MediaSource* mediaSource, int payloadType) :
-        mMediaSource(mediaSource),
         mEnv(env),
+        mMediaSource(mediaSource),
+        mRegistry(NULL),
         mCsrcLen(0),
         mExtension(0),
         mPadding(0),
@@ -13,12 +15,16 @@ Sink::Sink(UsageEnvironment* env, MediaSource* mediaSource, int payloadType) :
         mPayloadType(payloadType),
         mMarker(0),
         mSeq(0),
-        mSSRC(rand()),
         mTimestamp(0),
+        mSSRC(rand()),
         mTimerId(0),
-        mSessionSendPacket(NULL),
-        mArg1(NULL),
-        mArg2(NULL)
+        mPeriodNum(0),
+        mPeriodDen(1),
+        mClockStart(0),
+        mFrameCount(0),
+        mFrameIndex(0),
+        mGopCacheEnabled(false),
+        mGopCacheBytes(0)
 {
 
     LOGI("Sink()");
@@ -31,11 +37,14 @@ Sink::Sink(UsageEnvironment* env, MediaSource* mediaSource, int payloadType) :
 Sink::~Sink(){
     LOGI("~Sink()");
 
-    //mEnv->scheduler()->removeTimedEvent(mTimerId);// 从定时器中删除，由定时器内部自己已实现，这里不再需要调用
+    mEnv->scheduler()->removeTimedEvent(mTimerId);// 下一帧的定时器是一次性的，必须在删除mTimerEvent之前取消
 
     delete mTimerEvent;
     delete mMediaSource;
 
+    if (mRegistry)
+        mRegistry->removeSink(this);
+
     //Delete::release(mTimerEvent);
 }
 void Sink::stopTimerEvent() {
@@ -43,17 +52,39 @@ void Sink::stopTimerEvent() {
     mTimerEvent->stop();
 
 }
-void Sink::setSessionCb(SessionSendPacketCallback cb, void* arg1, void* arg2) {
+void Sink::addSessionCb(SessionSendPacketCallback cb, void* arg1, void* arg2) {
     // cb 被回调函数
     //arg1 mediaSession 对象指针
     //arg2 mediaSession 被回调track对象指针
-    mSessionSendPacket = cb;
-    mArg1 = arg1;
-    mArg2 = arg2;
+    SessionCb sessionCb;
+    sessionCb.mCb = cb;
+    sessionCb.mArg1 = arg1;
+    sessionCb.mArg2 = arg2;
+    mSessionCbs.push_back(sessionCb);
+}
+
+void Sink::removeSessionCb(void* arg1, void* arg2) {
+    for (std::vector<SessionCb>::iterator it = mSessionCbs.begin(); it != mSessionCbs.end(); ++it) {
+        if (it->mArg1 == arg1 && it->mArg2 == arg2) {
+            mSessionCbs.erase(it);
+            return;
+        }
+    }
 }
 
 void Sink::sendRtpPacket(RtpPacket* packet){
-    RtpHeader* rtpHeader = packet->mRtpHeader;
+    setRtpHeader(packet->mRtpHeader);
+
+    // 同一个RTP包依次交给所有引用该Sink的MediaSession
+    for (size_t i = 0; i < mSessionCbs.size(); ++i) {
+        //arg1 mediaSession 对象指针
+        //arg2 mediaSession 被回调track对象指针
+        mSessionCbs[i].mCb(mSessionCbs[i].mArg1, mSessionCbs[i].mArg2, packet, PacketType::RTPPACKET);
+    }
+
+}
+
+void Sink::setRtpHeader(RtpHeader* rtpHeader){
     rtpHeader->csrcLen = mCsrcLen;
     rtpHeader->extension = mExtension;
     rtpHeader->padding = mPadding;
@@ -63,13 +94,49 @@ void Sink::sendRtpPacket(RtpPacket* packet){
     rtpHeader->seq = htons(mSeq);
     rtpHeader->timestamp = htonl(mTimestamp);
     rtpHeader->ssrc = htonl(mSSRC);
+}
 
-    if(mSessionSendPacket){
-        //arg1 mediaSession 对象指针
-        //arg2 mediaSession 被回调track对象指针
-        mSessionSendPacket(mArg1, mArg2, packet, PacketType::RTPPACKET);
+void Sink::sendRtpPacketList(const RtpPacketListPtr& packetList){
+    packetList->setFrameIndex(++mFrameIndex);
+
+    // 先放入缓存再回调订阅者：PLAY时取到的缓存可能已包含本帧，由RtpInstance按编号去重，不会漏帧
+    if (mGopCacheEnabled)
+        cacheRtpPacketList(packetList);
+
+    // 一帧只封包一次，所有订阅者共享同一个只读的包列表
+    for (size_t i = 0; i < mSessionCbs.size(); ++i) {
+        mSessionCbs[i].mCb(mSessionCbs[i].mArg1, mSessionCbs[i].mArg2,
+                           (void*)&packetList, PacketType::RTPPACKETLIST);
+    }
+}
+
+void Sink::cacheRtpPacketList(const RtpPacketListPtr& packetList){
+    std::lock_guard <std::mutex> lck(mGopCacheMtx);
+
+    // 非关键帧之后的第一个关键帧开始新的GOP（SPS、PPS、IDR连续到达时属于同一个GOP）
+    if (packetList->isKeyFrame() && !mGopCache.empty() && !mGopCache.back()->isKeyFrame()) {
+        mGopCache.clear();
+        mGopCacheBytes = 0;
     }
 
+    // 缓存为空时只从关键帧开始，否则回放的帧无法解码
+    if (mGopCache.empty() && !packetList->isKeyFrame())
+        return;
+
+    if (mGopCacheBytes + packetList->size() > SINK_GOP_CACHE_MAX_BYTES) {
+        LOGI("gop cache exceeds %d bytes,drop it", SINK_GOP_CACHE_MAX_BYTES);
+        mGopCache.clear();
+        mGopCacheBytes = 0;
+        return;
+    }
+
+    mGopCache.push_back(packetList);
+    mGopCacheBytes += packetList->size();
+}
+
+void Sink::getGopCache(std::vector<RtpPacketListPtr>& packetLists){
+    std::lock_guard <std::mutex> lck(mGopCacheMtx);
+    packetLists = mGopCache;
 }
 
 void Sink::cbTimeout(void *arg) {
@@ -78,15 +145,44 @@ void Sink::cbTimeout(void *arg) {
 }
 void Sink::handleTimeout() {
     MediaFrame* frame = mMediaSource->getFrameFromOutputQueue();
-    if (!frame) {
-        return;
+    if (frame) {
+        this->sendFrame(frame);// 由具体子类实现发送逻辑
+
+        mMediaSource->putFrameToInputQueue(frame);//将使用过的frame插入输入队列，插入输入队列以后，加入一个子线程task，从文件中读取数据再次将输入写入到frame
     }
-    this->sendFrame(frame);// 由具体子类实现发送逻辑
 
-    mMediaSource->putFrameToInputQueue(frame);//将使用过的frame插入输入队列，插入输入队列以后，加入一个子线程task，从文件中读取数据再次将输入写入到frame
+    scheduleNextFrame();
 }
-// runEvery 函数使得 Sink 类中的某个任务可以在指定的时间间隔内重复执行。这对于需要定时处理的操作（如定期检查状态、发送心跳包等）非常有用。
-void Sink::runEvery(int interval){
-    mTimerId = mEnv->scheduler()->addTimedEventRunEvery(mTimerEvent, interval);
+
+// 第frameCount帧相对于媒体时钟起点的纳秒数，按整数分开计算，避免周期取整带来的累计误差和长时间运行后的溢出
+Timer::TimeIntervalNs Sink::mediaClockOffset(uint64_t frameCount) const {
+    uint64_t units = frameCount * mPeriodNum;
+    return (Timer::TimeIntervalNs)(units / mPeriodDen) * 1000000000 +
+           (Timer::TimeIntervalNs)(units % mPeriodDen) * 1000000000 / mPeriodDen;
+}
+
+// 每次都从理想的下一帧时间安排一次性定时器，定时器的触发误差不会累计
+void Sink::scheduleNextFrame() {
+    ++mFrameCount;
+    Timer::TimestampNs next = mClockStart + mediaClockOffset(mFrameCount);
+    Timer::TimestampNs now = Timer::getCurTimeNs();
+
+    // 落后超过一帧（如线程被长时间阻塞），以当前时间重新设置起点，避免连续补发造成突发
+    if (now - next > mediaClockOffset(1)) {
+        mClockStart = now;
+        mFrameCount = 1;
+        next = mClockStart + mediaClockOffset(mFrameCount);
+    }
+
+    mTimerId = mEnv->scheduler()->addTimedEventRunAtNs(mTimerEvent, next);
 }
 
+// runEvery 函数使得 Sink 类中的某个任务可以在指定的时间间隔内重复执行。这对于需要定时处理的操作（如定期检查状态、发送心跳包等）非常有用。
+void Sink::runEvery(uint32_t periodNum, uint32_t periodDen){
+    mPeriodNum = periodNum;
+    mPeriodDen = periodDen;
+    mClockStart = Timer::getCurTimeNs();
+    mFrameCount = 0;
+
+    scheduleNextFrame();
+}
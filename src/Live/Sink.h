@@ -1,6 +1,8 @@
 ﻿#ifndef ZYX_RTSPSERVER_SINK_H
 #define ZYX_RTSPSERVER_SINK_H
 #include <string>
+#include <vector>
+#include <mutex>
 #include <stdint.h>
 
 #include "Rtp.h"
@@ -8,6 +10,9 @@
 #include "../Scheduler/Event.h"
 #include "../Scheduler/UsageEnvironment.h"
 
+class MediaRegistry;
+
+#define SINK_GOP_CACHE_MAX_BYTES (1536 * 1024) // GOP缓存的上限，超过后放弃本GOP，等待下一个关键帧；须小于TCP_DEFAULT_HIGH_WATER_MARK，回放不会触发丢帧
 
 class Sink
 {
@@ -16,6 +21,7 @@ public:
     {
         UNKNOWN = -1,
         RTPPACKET = 0,
+        RTPPACKETLIST = 1,// packet为RtpPacketListPtr*
     };
 
     typedef void (*SessionSendPacketCallback)(void* arg1, void* arg2, void* packet, PacketType packetType);
@@ -28,25 +34,45 @@ public:
     virtual std::string getMediaDescription(uint16_t port) = 0;
     virtual std::string getAttribute() = 0;
 
-    void setSessionCb(SessionSendPacketCallback cb,void* arg1, void* arg2);
+    // 一个Sink可以被多个MediaSession共享，每帧封包一次后依次回调所有订阅者
+    void addSessionCb(SessionSendPacketCallback cb,void* arg1, void* arg2);
+    void removeSessionCb(void* arg1, void* arg2);
+    bool hasSessionCb() const { return !mSessionCbs.empty(); }
+    void setRegistry(MediaRegistry* registry) { mRegistry = registry; }
+
+    // GOP缓存：保存最近一个关键帧（含SPS/PPS）以来的所有包列表，新订阅者PLAY时先回放，无需等待下一个IDR
+    // 线程安全，可在连接所在的工作线程中调用
+    void getGopCache(std::vector<RtpPacketListPtr>& packetLists);
 
 protected:
 
     virtual void sendFrame(MediaFrame* frame) = 0;
     void sendRtpPacket(RtpPacket* packet);
+    void setRtpHeader(RtpHeader* rtpHeader);// 按当前的mSeq、mMarker、mTimestamp等填写RTP头
+    void sendRtpPacketList(const RtpPacketListPtr& packetList);// 整帧交给所有订阅者
+    void setGopCacheEnabled(bool enabled) { mGopCacheEnabled = enabled; }
 
-    void runEvery(int interval);
+    // 按媒体时钟每 periodNum/periodDen 秒发送一帧，例如视频(1, fps)，AAC(1024, 采样率)
+    void runEvery(uint32_t periodNum, uint32_t periodDen);
 private:
 
     static void cbTimeout(void* arg);
     void handleTimeout();
+    Timer::TimeIntervalNs mediaClockOffset(uint64_t frameCount) const;
+    void scheduleNextFrame();
+    void cacheRtpPacketList(const RtpPacketListPtr& packetList);
 
 protected:
     UsageEnvironment* mEnv;
     MediaSource* mMediaSource;
-    SessionSendPacketCallback mSessionSendPacket;
-    void* mArg1;
-    void* mArg2;
+    struct SessionCb
+    {
+        SessionSendPacketCallback mCb;
+        void* mArg1;
+        void* mArg2;
+    };
+    std::vector<SessionCb> mSessionCbs;
+    MediaRegistry* mRegistry;
 
     uint8_t mCsrcLen;
     uint8_t mExtension;
@@ -61,6 +87,16 @@ protected:
 private:
     TimerEvent* mTimerEvent;
     Timer::TimerId mTimerId;// runEvery()之后获取
+    uint32_t mPeriodNum;
+    uint32_t mPeriodDen;
+    Timer::TimestampNs mClockStart;// 媒体时钟起点
+    uint64_t mFrameCount;// 自起点以来的帧数，第n帧的发送时间为 mClockStart + n * 周期
+
+    uint64_t mFrameIndex;// 最后一个分发的包列表的编号
+    bool mGopCacheEnabled;
+    std::vector<RtpPacketListPtr> mGopCache;
+    int mGopCacheBytes;
+    std::mutex mGopCacheMtx;// 缓存在Sink所在线程写入，在各连接的工作线程读取
 };
 
 #endif //ZYX_RTSPSERVER_SINK_H
\ No newline at end of file
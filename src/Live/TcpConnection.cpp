@@ -1,12 +1,22 @@
 #include "TcpConnection.h"
+#include <string.h>
+#include <errno.h>
 #include "../Scheduler/SocketsOps.h"
 #include "../Base/Log.h"
 
+#define TCP_WRITEV_MAX_IOV 256 // 每次writev最多提交的iovec个数
+
 
 TcpConnection::TcpConnection(UsageEnvironment* env, int clientFd) :
         mEnv(env),
-        mClientFd(clientFd)
+        mClientFd(clientFd),
+        mOutQueueBytes(0),
+        mOutOffset(0),
+        mHighWaterMark(TCP_DEFAULT_HIGH_WATER_MARK)
 {
+    memset(mSkipToKeyFrame, 0, sizeof(mSkipToKeyFrame));
+    mIovecs.resize(TCP_WRITEV_MAX_IOV);
+
     mClientIOEvent = IOEvent::createNew(clientFd, this);
     mClientIOEvent->setReadCallback(readCallback);
     mClientIOEvent->setWriteCallback(writeCallback);
@@ -119,9 +129,222 @@ void TcpConnection::handleDisConnect()
 }
 void TcpConnection::handleWrite()
 {
-    LOGI("");
-    mOutBuffer.retrieveAll();
+    flushOutQueue();
+}
+
+int TcpConnection::send(const void* buf, int size)
+{
+    if (size <= 0)
+        return 0;
+
+    mOutQueue.push_back(OutEntry());
+    OutEntry& entry = mOutQueue.back();
+    entry.mMessage.assign((const char*)buf, size);
+    entry.mSize = size;
+    mOutQueueBytes += size;
+
+    // 已在等待可写事件时说明发送缓冲区已满，由handleWrite继续发送，保证顺序
+    if (!mClientIOEvent->isWriteHandling()) {
+        if (!flushOutQueue())
+            return -1;
+    }
+
+    return size;
+}
+
+static void buildInterleavedHeader(uint8_t* header, uint8_t channel, int size)
+{
+    header[0] = '$';
+    header[1] = channel;
+    header[2] = (uint8_t)((size & 0xFF00) >> 8);
+    header[3] = (uint8_t)(size & 0xFF);
+}
+
+static bool isWouldBlock()
+{
+#ifndef WIN32
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+#else
+    return (WSAGetLastError() == WSAEWOULDBLOCK);
+#endif // !WIN32
+}
 
+void TcpConnection::sendPacketList(const RtpPacketListPtr& packetList, uint8_t channel)
+{
+    if (!admitPacketList(packetList, channel))
+        return;
+
+    int num = packetList->packetNum();
+    size_t frameSize = 0;
+
+    // interleaved头放在连接自己的数组中，与共享的只读包一起组成iovec，包本身不做任何修改
+    mHeaders.resize(num * RTP_TCP_HEADER_SIZE);
+    for (int i = 0; i < num; ++i) {
+        int size = packetList->packet(i).mSize;
+        buildInterleavedHeader(&mHeaders[i * RTP_TCP_HEADER_SIZE], channel, size);
+        frameSize += RTP_TCP_HEADER_SIZE + size;
+    }
+
+    size_t sent = 0;
+    bool full = false;// 发送缓冲区已满
+    bool empty = mOutQueue.empty();
+    if (empty) {
+        // 快速路径：没有积压时整帧一次writev直接发送，发完则不需要入队
+        int iovcnt = 0;
+        size_t iovBytes = 0;
+        for (int i = 0; i < num && iovcnt + 2 <= TCP_WRITEV_MAX_IOV; ++i) {
+            const RtpPacketList::Packet& packet = packetList->packet(i);
+            mIovecs[iovcnt].iov_base = &mHeaders[i * RTP_TCP_HEADER_SIZE];
+            mIovecs[iovcnt].iov_len = RTP_TCP_HEADER_SIZE;
+            mIovecs[iovcnt + 1].iov_base = packet.mBuf;
+            mIovecs[iovcnt + 1].iov_len = packet.mSize;
+            iovcnt += 2;
+            iovBytes += RTP_TCP_HEADER_SIZE + packet.mSize;
+        }
+
+        int ret = sockets::writev(mClientFd, &mIovecs[0], iovcnt);
+        if (ret < 0) {
+            if (!isWouldBlock()) {
+                LOGE("writev error,fd=%d", mClientFd);
+                return;
+            }
+            ret = 0;
+        }
+
+        sent = ret;
+        if (sent == frameSize)
+            return;
+        full = (sent < iovBytes);
+    }
+
+    // 未发完的部分入队，队列项保存自己的interleaved头
+    mOutQueue.push_back(OutEntry());
+    OutEntry& entry = mOutQueue.back();
+    entry.mPacketList = packetList;
+    entry.mHeaders = mHeaders;
+    entry.mSize = frameSize;
+    mOutQueueBytes += frameSize - sent;
+    if (empty)
+        mOutOffset = sent;
+
+    if (full)
+        enableWriteHandling();
+    else if (!mClientIOEvent->isWriteHandling())
+        flushOutQueue();
+}
+
+/*
+    丢帧策略（只丢弃新到的帧，已入队的帧保持完整）：
+    1. 队列超过高水位的一半时，先丢弃非参考帧；
+    2. 超过高水位时，该channel丢弃所有帧直到下一个关键帧，且队列已回落到高水位以下。
+*/
+bool TcpConnection::admitPacketList(const RtpPacketListPtr& packetList, uint8_t channel)
+{
+    if (mSkipToKeyFrame[channel]) {
+        if (!packetList->isKeyFrame() || mOutQueueBytes >= mHighWaterMark)
+            return false;
+
+        mSkipToKeyFrame[channel] = false;
+        LOGI("fd=%d,channel=%d resume at key frame,queued=%d", mClientFd, channel, (int)mOutQueueBytes);
+        return true;
+    }
+
+    if (mOutQueueBytes >= mHighWaterMark) {
+        mSkipToKeyFrame[channel] = true;
+        LOGI("fd=%d,channel=%d over high water mark,skip to next key frame,queued=%d",
+             mClientFd, channel, (int)mOutQueueBytes);
+        return false;
+    }
+
+    if (mOutQueueBytes >= mHighWaterMark / 2 && !packetList->isReference())
+        return false;
+
+    return true;
+}
+
+static void appendIov(struct iovec* iov, int& iovcnt, size_t& skip, const void* base, size_t len)
+{
+    if (skip >= len) {
+        skip -= len;
+        return;
+    }
+
+    iov[iovcnt].iov_base = (char*)base + skip;
+    iov[iovcnt].iov_len = len - skip;
+    ++iovcnt;
+    skip = 0;
+}
+
+bool TcpConnection::flushOutQueue()
+{
+    struct iovec* iov = &mIovecs[0];
+
+    while (!mOutQueue.empty()) {
+        int iovcnt = 0;
+        size_t skip = mOutOffset;
+        size_t bytes = 0;
+
+        for (std::deque<OutEntry>::iterator it = mOutQueue.begin();
+             it != mOutQueue.end() && iovcnt + 2 <= TCP_WRITEV_MAX_IOV; ++it) {
+            if (!it->mPacketList) {
+                appendIov(iov, iovcnt, skip, it->mMessage.data(), it->mMessage.size());
+                continue;
+            }
+
+            int num = it->mPacketList->packetNum();
+            for (int i = 0; i < num && iovcnt + 2 <= TCP_WRITEV_MAX_IOV; ++i) {
+                const RtpPacketList::Packet& packet = it->mPacketList->packet(i);
+                appendIov(iov, iovcnt, skip, &it->mHeaders[i * RTP_TCP_HEADER_SIZE], RTP_TCP_HEADER_SIZE);
+                appendIov(iov, iovcnt, skip, packet.mBuf, packet.mSize);
+            }
+        }
+
+        for (int i = 0; i < iovcnt; ++i)
+            bytes += iov[i].iov_len;
+
+        int ret = sockets::writev(mClientFd, iov, iovcnt);
+        if (ret < 0) {
+            if (isWouldBlock()) {
+                enableWriteHandling();
+                return true;
+            }
+
+            // 写出错（对端已关闭等），丢弃队列，由读事件感知断开
+            LOGE("writev error,fd=%d", mClientFd);
+            clearOutQueue();
+            return false;
+        }
+
+        retrieveOutQueue(ret);
+
+        if ((size_t)ret < bytes) {// 发送缓冲区已满，等待可写事件
+            enableWriteHandling();
+            return true;
+        }
+    }
+
+    disableWriteHandling();
+    return true;
+}
+
+void TcpConnection::clearOutQueue()
+{
+    mOutQueue.clear();
+    mOutQueueBytes = 0;
+    mOutOffset = 0;
+    disableWriteHandling();
+}
+
+void TcpConnection::retrieveOutQueue(size_t bytes)
+{
+    mOutQueueBytes -= bytes;
+
+    size_t left = mOutOffset + bytes;
+    while (!mOutQueue.empty() && left >= mOutQueue.front().mSize) {
+        left -= mOutQueue.front().mSize;
+        mOutQueue.pop_front();
+    }
+    mOutOffset = left;
 }
 
 void TcpConnection::handleError()
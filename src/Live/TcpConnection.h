@@ -1,8 +1,14 @@
 #ifndef ZYX_RTSPSERVER_TCPCONNECTION_H
 #define ZYX_RTSPSERVER_TCPCONNECTION_H
+#include <deque>
+#include <vector>
+#include <string>
 #include "../Scheduler/UsageEnvironment.h"
 #include "../Scheduler/Event.h"
 #include "Buffer.h"
+#include "Rtp.h"
+
+#define TCP_DEFAULT_HIGH_WATER_MARK (2 * 1024 * 1024) // ͶĬϸˮλֽڣ
 
 class TcpConnection
 {
@@ -13,6 +19,13 @@ public:
     virtual ~TcpConnection();
 
     void setDisConnectCallback(DisConnectCallback cb, void* arg);
+    void setHighWaterMark(size_t bytes) { mHighWaterMark = bytes; }
+    UsageEnvironment* env() const { return mEnv; }
+
+    // ·ͺֻ¼ѭеãݽ뷢ͶУȴд¼
+    int send(const void* buf, int size);
+    // RTP over TCPùİбchannelinterleavedͷӣˮλʱ֡Զ
+    void sendPacketList(const RtpPacketListPtr& packetList, uint8_t channel);
 
 protected:
     void enableReadHandling();
@@ -29,7 +42,13 @@ protected:
 
     void handleDisConnect();
 
+    bool flushOutQueue();// Ͷеݣfalseʾд
+
 private:
+    bool admitPacketList(const RtpPacketListPtr& packetList, uint8_t channel);
+    void retrieveOutQueue(size_t bytes);
+    void clearOutQueue();
+
     static void readCallback(void* arg);
     static void writeCallback(void* arg);
     static void errorCallback(void* arg);
@@ -41,8 +60,24 @@ protected:
     DisConnectCallback mDisConnectCallback;//RtspServerʵʵʱõĻص
     void* mArg;
     Buffer mInputBuffer;
-    Buffer mOutBuffer;
     char mBuffer[2048];
+
+private:
+    struct OutEntry
+    {
+        std::string mMessage;// RTSPϢ
+        RtpPacketListPtr mPacketList;// RTP over TCPһ֡İбֻ
+        std::vector<uint8_t> mHeaders;// ÿinterleavedͷɶԼ
+        size_t mSize;// ֽ
+    };
+
+    std::deque<OutEntry> mOutQueue;
+    size_t mOutQueueBytes;// δ͵ֽ
+    size_t mOutOffset;// ѷ͵ֽ
+    size_t mHighWaterMark;
+    bool mSkipToKeyFrame[256];// channel¼ѳˮλֱһؼ֡
+    std::vector<struct iovec> mIovecs;// writevʹõiovec飬ڸ
+    std::vector<uint8_t> mHeaders;// ֱӷ֡ʱʹõinterleavedͷڸ
 };
 
 #endif //ZYX_RTSPSERVER_TCPCONNECTION_H
\ No newline at end of file
@@ -0,0 +1,170 @@
+﻿#include "EPollPoller.h"
+#include "../Base/Log.h"
+#ifndef WIN32
+#include <unistd.h>
+#endif // !WIN32
+
+#define EPOLL_INIT_EVENT_NUM 64
+
+EPollPoller::EPollPoller(TriggerMode mode) :
+    mEPollFd(-1),
+    mTriggerMode(mode)
+{
+#ifndef WIN32
+    mEPollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEPollFd < 0) {
+        LOGE("epoll_create1 error");
+    }
+    mEPollEvents.resize(EPOLL_INIT_EVENT_NUM);
+#endif // !WIN32
+}
+
+EPollPoller::~EPollPoller()
+{
+#ifndef WIN32
+    if (mEPollFd >= 0)
+        ::close(mEPollFd);
+#endif // !WIN32
+}
+
+EPollPoller* EPollPoller::createNew(TriggerMode mode)
+{
+#ifndef WIN32
+    return new EPollPoller(mode);
+#else
+    return NULL;
+#endif // !WIN32
+}
+
+uint32_t EPollPoller::toEpollEvents(IOEvent* event) const
+{
+    uint32_t events = 0;
+#ifndef WIN32
+    if (event->isReadHandling())
+        events |= EPOLLIN | EPOLLRDHUP;
+    if (event->isWriteHandling())
+        events |= EPOLLOUT;
+    if (event->isErrorHandling())
+        events |= EPOLLPRI;// 对应select的exceptfds（带外数据）
+
+    if (mTriggerMode == EDGE_TRIGGERED)
+        events |= EPOLLET;
+#endif // !WIN32
+    return events;
+}
+
+bool EPollPoller::addIOEvent(IOEvent* event)
+{
+    return updateIOEvent(event);
+}
+
+// 与SelectPoller不同，epoll在内核中维护关注集合，这里只需在注册状态变化时调用epoll_ctl
+bool EPollPoller::updateIOEvent(IOEvent* event)
+{
+#ifndef WIN32
+    int fd = event->getFd();
+    if (fd < 0 || mEPollFd < 0)
+    {
+        LOGE("fd=%d,epollFd=%d", fd, mEPollFd);
+        return false;
+    }
+
+    struct epoll_event ev = { 0 };
+    ev.events = toEpollEvents(event);
+    ev.data.ptr = event;
+
+    IOEventMap::iterator it = mEventMap.find(fd);
+    if (it != mEventMap.end()) //先前已经添加则修改
+    {
+        if (epoll_ctl(mEPollFd, EPOLL_CTL_MOD, fd, &ev) < 0)
+        {
+            LOGE("epoll_ctl mod error,fd=%d", fd);
+            return false;
+        }
+        it->second = event;
+    }
+    else //先前未添加则添加IO事件
+    {
+        if (epoll_ctl(mEPollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            LOGE("epoll_ctl add error,fd=%d", fd);
+            return false;
+        }
+        mEventMap.insert(std::make_pair(fd, event));
+    }
+
+    return true;
+#else
+    return false;
+#endif // !WIN32
+}
+
+bool EPollPoller::removeIOEvent(IOEvent* event)
+{
+#ifndef WIN32
+    int fd = event->getFd();
+    if (fd < 0)
+        return false;
+
+    IOEventMap::iterator it = mEventMap.find(fd);
+    if (it == mEventMap.end())
+        return false;
+
+    mEventMap.erase(it);
+    epoll_ctl(mEPollFd, EPOLL_CTL_DEL, fd, NULL);
+
+    // 若本轮已返回但还未分发的事件中包含该对象，则将其置空，避免回调已删除的对象
+    for (auto& ioEvent : mIOEvents) {
+        if (ioEvent == event)
+            ioEvent = NULL;
+    }
+
+    return true;
+#else
+    return false;
+#endif // !WIN32
+}
+
+// epoll_wait只返回活跃的描述符，分发成本与活跃连接数成正比，与总连接数无关
+void EPollPoller::handleEvent()
+{
+#ifndef WIN32
+    int timeout = 1000 * 1000;// 毫秒，与SelectPoller保持一致
+    int num = epoll_wait(mEPollFd, &mEPollEvents[0], (int)mEPollEvents.size(), timeout);
+
+    if (num <= 0) {
+        return;
+    }
+
+    for (int i = 0; i < num; ++i)
+    {
+        uint32_t events = mEPollEvents[i].events;
+        IOEvent* ioEvent = (IOEvent*)mEPollEvents[i].data.ptr;
+        int rEvent = 0;
+
+        // 对端关闭或出错时以可读的方式通知，由读回调感知并断开连接（与select的行为一致）
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            rEvent |= IOEvent::EVENT_READ;
+
+        if (events & EPOLLOUT)
+            rEvent |= IOEvent::EVENT_WRITE;
+
+        if (events & (EPOLLPRI | EPOLLERR))
+            rEvent |= IOEvent::EVENT_ERROR;
+
+        ioEvent->setREvent(rEvent);
+        mIOEvents.push_back(ioEvent);
+    }
+
+    for (size_t i = 0; i < mIOEvents.size(); ++i) {
+        if (mIOEvents[i])
+            mIOEvents[i]->handleEvent();
+    }
+
+    mIOEvents.clear();
+
+    // 活跃描述符数量已占满输出数组，扩容以便下一轮一次取回更多事件
+    if (num == (int)mEPollEvents.size())
+        mEPollEvents.resize(mEPollEvents.size() * 2);
+#endif // !WIN32
+}
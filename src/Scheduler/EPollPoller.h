@@ -0,0 +1,41 @@
+﻿#ifndef ZYX_RTSPSERVER_EPOLLPOLLER_H
+#define ZYX_RTSPSERVER_EPOLLPOLLER_H
+#include "Poller.h"
+#include <vector>
+#include <stdint.h>
+#ifndef WIN32
+#include <sys/epoll.h>
+#endif // !WIN32
+
+class EPollPoller : public Poller
+{
+public:
+    enum TriggerMode
+    {
+        LEVEL_TRIGGERED,// 水平触发（默认），与SelectPoller语义一致
+        EDGE_TRIGGERED  // 边缘触发，回调必须一次性读/写到EAGAIN
+    };
+
+    explicit EPollPoller(TriggerMode mode);
+    virtual ~EPollPoller();
+
+    static EPollPoller* createNew(TriggerMode mode = LEVEL_TRIGGERED);
+
+    virtual bool addIOEvent(IOEvent* event);
+    virtual bool updateIOEvent(IOEvent* event);
+    virtual bool removeIOEvent(IOEvent* event);
+    virtual void handleEvent();
+
+private:
+    uint32_t toEpollEvents(IOEvent* event) const;
+
+private:
+    int mEPollFd;
+    TriggerMode mTriggerMode;
+#ifndef WIN32
+    std::vector<struct epoll_event> mEPollEvents;// epoll_wait输出数组，只包含活跃的描述符
+#endif // !WIN32
+    std::vector<IOEvent*> mIOEvents;// 存储临时活跃的IO事件对象
+};
+
+#endif //ZYX_RTSPSERVER_EPOLLPOLLER_H
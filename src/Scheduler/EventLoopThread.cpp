@@ -0,0 +1,70 @@
+﻿#include "EventLoopThread.h"
+#include "../Base/Log.h"
+#ifndef WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif // !WIN32
+
+EventLoopThread* EventLoopThread::createNew(EventScheduler::PollerType type, int cpu)
+{
+    return new EventLoopThread(type, cpu);
+}
+
+EventLoopThread::EventLoopThread(EventScheduler::PollerType type, int cpu) :
+    mPollerType(type),
+    mCpu(cpu),
+    mScheduler(NULL),
+    mIsStop(false)
+{
+
+}
+
+EventLoopThread::~EventLoopThread()
+{
+    stopLoop();
+    delete mScheduler;
+}
+
+EventScheduler* EventLoopThread::startLoop()
+{
+    start(NULL);
+
+    std::unique_lock <std::mutex> lck(mMtx);
+    while (mScheduler == NULL) {
+        mCon.wait(lck);
+    }
+    return mScheduler;
+}
+
+void EventLoopThread::stopLoop()
+{
+    if (mScheduler && !mIsStop) {
+        mScheduler->quit();
+        join();
+        mIsStop = true;
+    }
+}
+
+void EventLoopThread::run(void* arg)
+{
+#ifndef WIN32
+    if (mCpu >= 0) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(mCpu, &cpuSet);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+            LOGE("pthread_setaffinity_np error,cpu=%d", mCpu);
+        }
+    }
+#endif // !WIN32
+
+    // EventScheduler在本线程内创建，其poller、定时器均归属本线程
+    EventScheduler* scheduler = EventScheduler::createNew(mPollerType);
+    {
+        std::lock_guard <std::mutex> lck(mMtx);
+        mScheduler = scheduler;
+        mCon.notify_one();
+    }
+
+    scheduler->loop();
+}
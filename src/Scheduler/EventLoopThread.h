@@ -0,0 +1,34 @@
+﻿#ifndef ZYX_RTSPSERVER_EVENTLOOPTHREAD_H
+#define ZYX_RTSPSERVER_EVENTLOOPTHREAD_H
+#include <mutex>
+#include <condition_variable>
+#include "Thread.h"
+#include "EventScheduler.h"
+
+// 在独立线程中运行一个EventScheduler，多Reactor模式下每个工作循环对应一个EventLoopThread
+class EventLoopThread : public Thread
+{
+public:
+    static EventLoopThread* createNew(EventScheduler::PollerType type, int cpu);
+
+    // cpu < 0 表示不绑定CPU核
+    EventLoopThread(EventScheduler::PollerType type, int cpu);
+    virtual ~EventLoopThread();
+
+    EventScheduler* startLoop();// 启动线程，并等待线程内的EventScheduler创建完成
+    void stopLoop();// 退出loop并等待线程结束，EventScheduler在析构时释放
+    EventScheduler* scheduler() const { return mScheduler; }
+
+protected:
+    virtual void run(void* arg);
+
+private:
+    EventScheduler::PollerType mPollerType;
+    int mCpu;
+    EventScheduler* mScheduler;
+    bool mIsStop;
+    std::mutex mMtx;
+    std::condition_variable mCon;
+};
+
+#endif //ZYX_RTSPSERVER_EVENTLOOPTHREAD_H
@@ -1,12 +1,15 @@
 ﻿#include "EventScheduler.h"
 #include "SocketsOps.h"
 #include "SelectPoller.h"
-//#include "PollPoller.h"
-//#include "EPollPoller.h"
+#include "PollPoller.h"
+#include "EPollPoller.h"
 #include "../Base/Log.h"
 
+#define PENDING_TASK_BATCH_NUM 1024
+
 #ifndef WIN32
 #include <sys/eventfd.h>
+#include <unistd.h>
 #endif // !WIN32
 
 EventScheduler* EventScheduler::createNew(PollerType type)
@@ -17,7 +20,11 @@ EventScheduler* EventScheduler::createNew(PollerType type)
     return new EventScheduler(type);
 }
 
-EventScheduler::EventScheduler(PollerType type) : mQuit(false) {
+EventScheduler::EventScheduler(PollerType type) :
+    mQuit(false),
+    mPollerType(type),
+    mHandlingPendingTasks(false),
+    mThreadId(std::this_thread::get_id()) {
 
 #ifdef WIN32
     WSADATA wdSockMsg;//这是一个结构体
@@ -59,13 +66,15 @@ EventScheduler::EventScheduler(PollerType type) : mQuit(false) {
             mPoller = SelectPoller::createNew();
             break;
 
-            //case POLLER_POLL:
-            //    mPoller = PollPoller::createNew();
-            //    break;
+        case POLLER_POLL:
+            mPoller = PollPoller::createNew();
+            break;
 
-            //case POLLER_EPOLL:
-            //    mPoller = EPollPoller::createNew();
-            //    break;
+#ifndef WIN32
+        case POLLER_EPOLL:
+            mPoller = EPollPoller::createNew();
+            break;
+#endif // !WIN32
 
         default:
             _exit(-1);
@@ -76,10 +85,32 @@ EventScheduler::EventScheduler(PollerType type) : mQuit(false) {
     */
     mTimerManager = TimerManager::createNew(this);//WIN系统的定时器回调由子线程托管，非WIN系统则通过select网络模型
 
+#ifndef WIN32
+    // 其他线程投递事件后通过写eventfd唤醒阻塞在poller中的loop
+    mWakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mWakeupFd < 0) {
+        LOGE("create eventfd error");
+        mWakeupIOEvent = NULL;
+    }
+    else {
+        mWakeupIOEvent = IOEvent::createNew(mWakeupFd, this);
+        mWakeupIOEvent->setReadCallback(wakeupReadCallback);
+        mWakeupIOEvent->enableReadHandling();
+        mPoller->addIOEvent(mWakeupIOEvent);
+    }
+#endif // !WIN32
+
 }
 
 EventScheduler::~EventScheduler()
 {
+#ifndef WIN32
+    if (mWakeupIOEvent) {
+        mPoller->removeIOEvent(mWakeupIOEvent);
+        delete mWakeupIOEvent;
+        ::close(mWakeupFd);
+    }
+#endif // !WIN32
 
     delete mTimerManager;
     delete mPoller;
@@ -92,27 +123,64 @@ EventScheduler::~EventScheduler()
 
 bool EventScheduler::addTriggerEvent(TriggerEvent* event)
 {
-    mTriggerEvents.push_back(event);
+    queueInLoop(triggerEventCallback, event);
 
     return true;
 }
 
+void EventScheduler::triggerEventCallback(void* arg)
+{
+    TriggerEvent* event = (TriggerEvent*)arg;
+    event->handleEvent();
+}
+
+void EventScheduler::runInLoop(EventCallback cb, void* arg)
+{
+    if (isInLoopThread())
+        cb(arg);
+    else
+        queueInLoop(cb, arg);
+}
+
+void EventScheduler::queueInLoop(EventCallback cb, void* arg)
+{
+    PendingTask task;
+    task.mCallback = cb;
+    task.mArg = arg;
+    mPendingTasks.push(task);
+
+    // 其他线程投递时loop可能阻塞在poller中；loop线程在执行任务期间投递的任务要到下一轮才执行，
+    // 同样需要唤醒，避免下一轮阻塞在poller中。push完成之后再唤醒，保证不会丢失唤醒
+    if (!isInLoopThread() || mHandlingPendingTasks)
+        wakeup();
+}
+
 Timer::TimerId EventScheduler::addTimedEventRunAfater(TimerEvent* event, Timer::TimeInterval delay)
 {
-    Timer::Timestamp timestamp = Timer::getCurTime();
-    timestamp += delay;
+    Timer::TimestampNs timestamp = Timer::getCurTimeNs();
+    timestamp += (Timer::TimeIntervalNs)delay * 1000000;
 
     return mTimerManager->addTimer(event, timestamp, 0);
 }
 
 Timer::TimerId EventScheduler::addTimedEventRunAt(TimerEvent* event, Timer::Timestamp when)
 {
-    return mTimerManager->addTimer(event, when, 0);
+    return mTimerManager->addTimer(event, when * 1000000, 0);
 }
 // addTimedEventRunEvery 方法的作用是将一个定时事件添加到事件调度器中，使其在指定的时间间隔内重复执行。
 Timer::TimerId EventScheduler::addTimedEventRunEvery(TimerEvent* event, Timer::TimeInterval interval)
 {
-    Timer::Timestamp timestamp = Timer::getCurTime();
+    return addTimedEventRunEveryNs(event, (Timer::TimeIntervalNs)interval * 1000000);
+}
+
+Timer::TimerId EventScheduler::addTimedEventRunAtNs(TimerEvent* event, Timer::TimestampNs when)
+{
+    return mTimerManager->addTimer(event, when, 0);
+}
+
+Timer::TimerId EventScheduler::addTimedEventRunEveryNs(TimerEvent* event, Timer::TimeIntervalNs interval)
+{
+    Timer::TimestampNs timestamp = Timer::getCurTimeNs();
     timestamp += interval;
 
     return mTimerManager->addTimer(event, timestamp, interval);
@@ -152,23 +220,58 @@ void EventScheduler::loop() {
 #endif // WIN32
 
     while (!mQuit) {
-        handleTriggerEvents(); // 关闭、清理相关操作
+        handlePendingTasks(); // 关闭、清理相关操作以及其他线程投递的任务
         mPoller->handleEvent();// 处理I/O事件，select操作
     }
 }
 
-void EventScheduler::handleTriggerEvents()
+void EventScheduler::quit()
 {
-    if (!mTriggerEvents.empty())
-    {
-        for (std::vector<TriggerEvent*>::iterator it = mTriggerEvents.begin();
-             it != mTriggerEvents.end(); ++it)
-        {
-            (*it)->handleEvent();
-        }
+    mQuit = true;
+    wakeup();
+}
+
+void EventScheduler::wakeup()
+{
+#ifndef WIN32
+    uint64_t one = 1;
+    ssize_t ret = ::write(mWakeupFd, &one, sizeof(one));
+    (void)ret;
+#endif // !WIN32
+}
 
-        mTriggerEvents.clear();
+void EventScheduler::wakeupReadCallback(void* arg)
+{
+    EventScheduler* scheduler = (EventScheduler*)arg;
+    scheduler->handleWakeupRead();
+}
+
+void EventScheduler::handleWakeupRead()
+{
+#ifndef WIN32
+    uint64_t value;
+    ssize_t ret = ::read(mWakeupFd, &value, sizeof(value));
+    (void)ret;
+#endif // !WIN32
+}
+
+void EventScheduler::handlePendingTasks()
+{
+    mHandlingPendingTasks = true;
+
+    // 每轮最多执行一批任务，剩余的留到下一轮，避免任务不断投递新任务导致IO事件得不到处理
+    PendingTask task;
+    int num = 0;
+    while (num < PENDING_TASK_BATCH_NUM && mPendingTasks.pop(task))
+    {
+        task.mCallback(task.mArg);
+        ++num;
     }
+
+    mHandlingPendingTasks = false;
+
+    if (num == PENDING_TASK_BATCH_NUM)
+        wakeup();
 }
 
 Poller* EventScheduler::poller() {
@@ -3,10 +3,12 @@
 
 #include <vector>
 #include <queue>
-#include <mutex>
+#include <atomic>
+#include <thread>
 #include <stdint.h>
 #include "Timer.h"
 #include "Event.h"
+#include "MpscQueue.h"
 class Poller;
 
 class EventScheduler
@@ -23,30 +25,52 @@ public:
     explicit EventScheduler(PollerType type);
     virtual ~EventScheduler();
 public:
-    bool addTriggerEvent(TriggerEvent* event);
+    bool addTriggerEvent(TriggerEvent* event);// 线程安全，可由其他线程调用
+    void runInLoop(EventCallback cb, void* arg);// 线程安全，在loop线程中调用时立即执行，否则投递到loop线程执行
+    void queueInLoop(EventCallback cb, void* arg);// 线程安全，投递到loop线程，在下一轮循环中执行
+    bool isInLoopThread() const { return mThreadId == std::this_thread::get_id(); }
     Timer::TimerId addTimedEventRunAfater(TimerEvent* event, Timer::TimeInterval delay);
     Timer::TimerId addTimedEventRunAt(TimerEvent* event, Timer::Timestamp when);
     Timer::TimerId addTimedEventRunEvery(TimerEvent* event, Timer::TimeInterval interval);
+    Timer::TimerId addTimedEventRunAtNs(TimerEvent* event, Timer::TimestampNs when);// when为Timer::getCurTimeNs()时间轴上的纳秒数
+    Timer::TimerId addTimedEventRunEveryNs(TimerEvent* event, Timer::TimeIntervalNs interval);
     bool removeTimedEvent(Timer::TimerId timerId);
     bool addIOEvent(IOEvent* event);
     bool updateIOEvent(IOEvent* event);
     bool removeIOEvent(IOEvent* event);
 
     void loop();
-    //    void wakeup();
+    void quit();// 线程安全，退出loop()
+    void wakeup();// 线程安全，唤醒阻塞在poller中的loop()
+    PollerType pollerType() const { return mPollerType; }
     Poller* poller();
     void setTimerManagerReadCallback(EventCallback cb, void* arg);
 
 private:
-    void handleTriggerEvents();
+    struct PendingTask
+    {
+        EventCallback mCallback;
+        void* mArg;
+    };
+
+    void handlePendingTasks();
+    static void triggerEventCallback(void* arg);
+    static void wakeupReadCallback(void* arg);
+    void handleWakeupRead();
 
 private:
-    bool mQuit;
+    std::atomic<bool> mQuit;
+    PollerType mPollerType;
     Poller* mPoller;
     TimerManager* mTimerManager;
-    std::vector<TriggerEvent*> mTriggerEvents;
+    MpscQueue<PendingTask> mPendingTasks;// 其他线程投递的任务（含触发事件），只由loop线程取出执行
+    bool mHandlingPendingTasks;// 仅loop线程读写
+    std::thread::id mThreadId;// 创建EventScheduler的线程，loop()须在该线程中调用
 
-    std::mutex mMtx;
+#ifndef WIN32
+    int mWakeupFd;// eventfd，其他线程写入以唤醒loop
+    IOEvent* mWakeupIOEvent;
+#endif // !WIN32
 
     // WIN系统专用的定时器回调start
     EventCallback mTimerManagerReadCallback;
@@ -0,0 +1,66 @@
+﻿#ifndef ZYX_RTSPSERVER_MPSCQUEUE_H
+#define ZYX_RTSPSERVER_MPSCQUEUE_H
+#include <atomic>
+#include <stddef.h>
+
+// 无锁多生产者单消费者队列（Vyukov算法）
+// push可由任意线程并发调用，且只包含一次原子交换；pop只能由唯一的消费者线程调用
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() :
+        mHead(new Node()),
+        mTail(mHead.load(std::memory_order_relaxed))
+    {
+
+    }
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(value)) {}
+        delete mTail;
+    }
+
+    void push(const T& value)
+    {
+        Node* node = new Node(value);
+        Node* prev = mHead.exchange(node, std::memory_order_acq_rel);
+        prev->mNext.store(node, std::memory_order_release);
+    }
+
+    // 队列为空时返回false。生产者交换mHead之后、链接mNext之前的瞬间也可能返回false，
+    // 因此生产者应在push完成之后再唤醒消费者
+    bool pop(T& value)
+    {
+        Node* tail = mTail;
+        Node* next = tail->mNext.load(std::memory_order_acquire);
+        if (next == NULL)
+            return false;
+
+        value = next->mValue;
+        mTail = next;
+        delete tail;
+        return true;
+    }
+
+private:
+    struct Node
+    {
+        Node() : mNext(NULL) {}
+        explicit Node(const T& value) : mNext(NULL), mValue(value) {}
+
+        std::atomic<Node*> mNext;
+        T mValue;
+    };
+
+    MpscQueue(const MpscQueue&);
+    MpscQueue& operator=(const MpscQueue&);
+
+private:
+    std::atomic<Node*> mHead;// 生产者端
+    Node* mTail;// 消费者端，指向已出队的哨兵节点
+};
+
+#endif //ZYX_RTSPSERVER_MPSCQUEUE_H
@@ -0,0 +1,150 @@
+﻿#include "PollPoller.h"
+#include "../Base/Log.h"
+
+PollPoller::PollPoller()
+{
+
+}
+
+PollPoller::~PollPoller()
+{
+
+}
+
+PollPoller* PollPoller::createNew()
+{
+    return new PollPoller();
+}
+
+short PollPoller::toPollEvents(IOEvent* event) const
+{
+    short events = 0;
+    if (event->isReadHandling())
+        events |= POLLIN;
+    if (event->isWriteHandling())
+        events |= POLLOUT;
+#ifndef WIN32
+    if (event->isErrorHandling())
+        events |= POLLPRI;// 对应select的exceptfds（带外数据）
+#endif // !WIN32
+    return events;
+}
+
+bool PollPoller::addIOEvent(IOEvent* event)
+{
+    return updateIOEvent(event);
+}
+
+bool PollPoller::updateIOEvent(IOEvent* event)
+{
+    int fd = event->getFd();
+    if (fd < 0)
+    {
+        LOGE("fd=%d", fd);
+
+        return false;
+    }
+
+    std::map<int, int>::iterator it = mPollFdIndex.find(fd);
+    if (it != mPollFdIndex.end()) //先前已经添加则修改
+    {
+        int index = it->second;
+        mPollFds[index].events = toPollEvents(event);
+        mPollEvents[index] = event;
+    }
+    else //先前未添加则追加到数组末尾
+    {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = toPollEvents(event);
+        pfd.revents = 0;
+
+        mPollFdIndex.insert(std::make_pair(fd, (int)mPollFds.size()));
+        mPollFds.push_back(pfd);
+        mPollEvents.push_back(event);
+        mEventMap.insert(std::make_pair(fd, event));
+    }
+
+    return true;
+}
+
+bool PollPoller::removeIOEvent(IOEvent* event)
+{
+    int fd = event->getFd();
+    if (fd < 0)
+        return false;
+
+    std::map<int, int>::iterator it = mPollFdIndex.find(fd);
+    if (it == mPollFdIndex.end())
+        return false;
+
+    // 用最后一个元素覆盖被删除的位置，数组保持紧凑且删除为O(1)移动
+    int index = it->second;
+    int last = (int)mPollFds.size() - 1;
+    if (index != last)
+    {
+        mPollFds[index] = mPollFds[last];
+        mPollEvents[index] = mPollEvents[last];
+        mPollFdIndex[mPollFds[index].fd] = index;
+    }
+    mPollFds.pop_back();
+    mPollEvents.pop_back();
+    mPollFdIndex.erase(it);
+    mEventMap.erase(fd);
+
+    // 若本轮已返回但还未分发的事件中包含该对象，则将其置空，避免回调已删除的对象
+    for (auto& ioEvent : mIOEvents) {
+        if (ioEvent == event)
+            ioEvent = NULL;
+    }
+
+    return true;
+}
+
+void PollPoller::handleEvent()
+{
+    if (mPollFds.empty())
+        return;
+
+    int timeout = 1000 * 1000;// 毫秒，与SelectPoller保持一致
+#ifndef WIN32
+    int ret = ::poll(&mPollFds[0], mPollFds.size(), timeout);
+#else
+    int ret = ::WSAPoll(&mPollFds[0], (ULONG)mPollFds.size(), timeout);
+#endif // !WIN32
+
+    if (ret <= 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < mPollFds.size() && ret > 0; ++i)
+    {
+        short revents = mPollFds[i].revents;
+        if (revents == 0)
+            continue;
+
+        --ret;
+        int rEvent = 0;
+
+        // 对端关闭或出错时以可读的方式通知，由读回调感知并断开连接（与select的行为一致）
+        if (revents & (POLLIN | POLLHUP | POLLERR))
+            rEvent |= IOEvent::EVENT_READ;
+
+        if (revents & POLLOUT)
+            rEvent |= IOEvent::EVENT_WRITE;
+
+        if (revents & (POLLPRI | POLLERR | POLLNVAL))
+            rEvent |= IOEvent::EVENT_ERROR;
+
+        mPollFds[i].revents = 0;
+        mPollEvents[i]->setREvent(rEvent);
+        mIOEvents.push_back(mPollEvents[i]);
+    }
+
+    for (size_t i = 0; i < mIOEvents.size(); ++i) {
+        if (mIOEvents[i])
+            mIOEvents[i]->handleEvent();
+    }
+
+    mIOEvents.clear();
+}
@@ -0,0 +1,36 @@
+﻿#ifndef ZYX_RTSPSERVER_POLLPOLLER_H
+#define ZYX_RTSPSERVER_POLLPOLLER_H
+#include "Poller.h"
+#include <vector>
+#ifndef WIN32
+#include <poll.h>
+#else
+#pragma comment(lib, "ws2_32.lib")
+#include <WinSock2.h>
+#endif // !WIN32
+
+class PollPoller : public Poller
+{
+public:
+    PollPoller();
+    virtual ~PollPoller();
+
+    static PollPoller* createNew();
+
+    virtual bool addIOEvent(IOEvent* event);
+    virtual bool updateIOEvent(IOEvent* event);
+    virtual bool removeIOEvent(IOEvent* event);
+    virtual void handleEvent();
+
+private:
+    short toPollEvents(IOEvent* event) const;
+
+private:
+    // mPollFds与mPollEvents下标一一对应且始终保持紧凑，删除时用末尾元素填补空位
+    std::vector<struct pollfd> mPollFds;
+    std::vector<IOEvent*> mPollEvents;
+    std::map<int, int> mPollFdIndex;// <fd,在mPollFds中的下标>
+    std::vector<IOEvent*> mIOEvents;// 存储临时活跃的IO事件对象
+
+};
+#endif //ZYX_RTSPSERVER_POLLPOLLER_H
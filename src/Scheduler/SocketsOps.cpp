@@ -1,11 +1,14 @@
 ﻿#include "SocketsOps.h"
 #include <fcntl.h>
+#include <string.h>
+#include <errno.h>
 #include <sys/types.h>          /* See NOTES */
 #ifndef WIN32
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/uio.h>
 #include <sys/ioctl.h>
+#include <netinet/udp.h>
 #include <net/if.h>
 #endif // !WIN32
 #include "../Base/Log.h"
@@ -113,6 +116,24 @@ int sockets::write(int sockfd, const void* buf, int size)
 
 }
 
+int sockets::writev(int sockfd, const struct iovec* iov, int iovcnt)
+{
+#ifndef WIN32
+    return ::writev(sockfd, iov, iovcnt);
+#else
+    int total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        int ret = ::send(sockfd, (char*)iov[i].iov_base, (int)iov[i].iov_len, 0);
+        if (ret < 0)
+            return total > 0 ? total : ret;
+        total += ret;
+        if (ret < (int)iov[i].iov_len)
+            break;
+    }
+    return total;
+#endif
+}
+
 int sockets::sendto(int sockfd, const void* buf, int len,
     const struct sockaddr* destAddr)
 {
@@ -120,6 +141,79 @@ int sockets::sendto(int sockfd, const void* buf, int len,
     return ::sendto(sockfd, (char*)buf, len, 0, destAddr, addrLen);
 }
 
+#define SENDMMSG_BATCH_NUM 64
+
+int sockets::sendmmsg(int sockfd, const struct iovec* bufs, int num,
+    const struct sockaddr* destAddr)
+{
+    int sent = 0;
+#ifndef WIN32
+    // 每次系统调用最多提交SENDMMSG_BATCH_NUM个数据报
+    struct mmsghdr msgs[SENDMMSG_BATCH_NUM];
+    while (sent < num) {
+        int batch = num - sent;
+        if (batch > SENDMMSG_BATCH_NUM)
+            batch = SENDMMSG_BATCH_NUM;
+
+        memset(msgs, 0, sizeof(struct mmsghdr) * batch);
+        for (int i = 0; i < batch; ++i) {
+            msgs[i].msg_hdr.msg_name = (void*)destAddr;
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr);
+            msgs[i].msg_hdr.msg_iov = (struct iovec*)&bufs[sent + i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int ret = ::sendmmsg(sockfd, msgs, batch, 0);
+        if (ret <= 0)
+            break;// 发送缓冲区满或出错，与sendto一样直接丢弃剩余的数据报
+
+        sent += ret;
+    }
+#else
+    for (; sent < num; ++sent) {
+        if (sendto(sockfd, bufs[sent].iov_base, (int)bufs[sent].iov_len, destAddr) < 0)
+            break;
+    }
+#endif // !WIN32
+
+    return sent;
+}
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103 // linux 4.18+，旧版本头文件中没有定义
+#endif
+
+int sockets::sendGso(int sockfd, const struct iovec* bufs, int num, uint16_t segSize,
+    const struct sockaddr* destAddr)
+{
+#ifndef WIN32
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = (void*)destAddr;
+    msg.msg_namelen = sizeof(struct sockaddr);
+    msg.msg_iov = (struct iovec*)bufs;
+    msg.msg_iovlen = num;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    memcpy(CMSG_DATA(cmsg), &segSize, sizeof(uint16_t));
+
+    if (::sendmsg(sockfd, &msg, 0) < 0)
+        return -errno;
+
+    return num;
+#else
+    return -EOPNOTSUPP;
+#endif // !WIN32
+}
+
 int sockets::setNonBlock(int sockfd)
 {
 #ifndef WIN32
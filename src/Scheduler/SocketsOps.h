@@ -6,9 +6,15 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/uio.h>
 #else
 #include <WinSock2.h>
 #include <WS2tcpip.h>
+struct iovec
+{
+    void* iov_base;
+    size_t iov_len;
+};
 #endif // !WIN32
 
 namespace sockets
@@ -20,7 +26,13 @@ namespace sockets
     int accept(int sockfd);
     // 通常是向描述符写数据
     int write(int sockfd, const void* buf, int size);// tcp 写入
+    int writev(int sockfd, const struct iovec* iov, int iovcnt);// tcp 聚集写入
     int sendto(int sockfd, const void* buf, int len, const struct sockaddr *destAddr); // udp 写入
+    // udp 批量写入：每个iovec作为一个数据报发往destAddr，返回成功发送的数据报个数
+    int sendmmsg(int sockfd, const struct iovec* bufs, int num, const struct sockaddr* destAddr);
+    // udp GSO写入：bufs拼接后由内核按segSize切分成多个数据报（最后一个可以更小），
+    // 成功返回数据报个数，失败返回-errno（不支持GSO时为-EIO/-EINVAL/-ENOPROTOOPT/-EOPNOTSUPP）
+    int sendGso(int sockfd, const struct iovec* bufs, int num, uint16_t segSize, const struct sockaddr* destAddr);
     int setNonBlock(int sockfd);// 设置非阻塞模式
     int setBlock(int sockfd, int writeTimeout); // 设置阻塞模式
     void setReuseAddr(int sockfd, int on);
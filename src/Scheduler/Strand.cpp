@@ -0,0 +1,46 @@
+﻿#include "Strand.h"
+
+Strand::Strand(ThreadPool* threadPool, StrandCallback cb, void* arg) :
+    mThreadPool(threadPool),
+    mCallback(cb),
+    mArg(arg),
+    mState(IDLE)
+{
+    mTask.setTaskCallback(taskCallback, this);
+}
+
+void Strand::post()
+{
+    int state = mState.load(std::memory_order_acquire);
+    for (;;) {
+        if (state == QUEUED || state == RUNNING_AGAIN)
+            return;
+
+        int next = (state == IDLE) ? QUEUED : RUNNING_AGAIN;
+        if (mState.compare_exchange_weak(state, next, std::memory_order_acq_rel))
+            break;
+    }
+
+    if (state == IDLE)
+        mThreadPool->addTask(mTask);
+}
+
+void Strand::taskCallback(void* arg)
+{
+    Strand* strand = (Strand*)arg;
+    strand->run();
+}
+
+void Strand::run()
+{
+    mState.store(RUNNING, std::memory_order_release);
+    mCallback(mArg);
+
+    int state = RUNNING;
+    if (mState.compare_exchange_strong(state, IDLE, std::memory_order_acq_rel))
+        return;
+
+    // 执行期间有新的post()：重新排到队尾而不是原地循环，避免一个繁忙的Strand长期占用工作线程
+    mState.store(QUEUED, std::memory_order_release);
+    mThreadPool->addTask(mTask);
+}
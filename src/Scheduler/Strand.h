@@ -0,0 +1,39 @@
+﻿#ifndef ZYX_RTSPSERVER_STRAND_H
+#define ZYX_RTSPSERVER_STRAND_H
+#include <atomic>
+#include "ThreadPool.h"
+
+/*
+    串行执行器：把同一个回调投递到线程池，保证同一时刻最多只有一个线程在执行它。
+    执行期间再次post()不会叠加任务，只标记执行完后需要再执行一次；已在队列中时post()直接返回。
+*/
+class Strand
+{
+public:
+    typedef ThreadPool::Task::TaskCallback StrandCallback;
+
+    Strand(ThreadPool* threadPool, StrandCallback cb, void* arg);
+
+    void post();// 线程安全
+
+private:
+    static void taskCallback(void* arg);
+    void run();
+
+    enum State
+    {
+        IDLE,       // 不在队列中，也没有在执行
+        QUEUED,     // 已投递到线程池，等待执行
+        RUNNING,    // 正在执行
+        RUNNING_AGAIN   // 正在执行，期间又有post()，执行完后重新投递
+    };
+
+private:
+    ThreadPool* mThreadPool;
+    StrandCallback mCallback;
+    void* mArg;
+    ThreadPool::Task mTask;
+    std::atomic<int> mState;
+};
+
+#endif //ZYX_RTSPSERVER_STRAND_H
@@ -52,7 +52,8 @@ bool Thread::join()
     mThreadId.join();
     //if(pthread_join(mThreadId, NULL))
     //    return false;
-    
+
+    mIsStart = false;// 已回收，析构时不能再detach
     return true;
 }
 
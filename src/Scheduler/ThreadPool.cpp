@@ -1,12 +1,28 @@
 ﻿#include "ThreadPool.h"
 #include "../Base/Log.h"
+
+// 当前线程所属的线程池及其工作线程下标，非工作线程为NULL
+static thread_local ThreadPool* tThreadPool = NULL;
+static thread_local int tWorkerIndex = -1;
+
+struct WorkerArg
+{
+    ThreadPool* mThreadPool;
+    int mIndex;
+};
+
 ThreadPool* ThreadPool::createNew(int num)
 {
     return new ThreadPool(num);
 }
 
 ThreadPool::ThreadPool(int num) :
-    mThreads(num),
+    mWorkerNum(num > 0 ? num : 1),
+    mWorkers(new Worker[mWorkerNum]),
+    mNextWorker(0),
+    mPendingTasks(0),
+    mIdleThreads(0),
+    mThreads(mWorkerNum),
     mQuit(false)
 {
     createThreads();
@@ -15,32 +31,74 @@ ThreadPool::ThreadPool(int num) :
 ThreadPool::~ThreadPool()
 {
     cancelThreads();
+    delete[] mWorkers;
 }
 
 void ThreadPool::addTask(ThreadPool::Task& task)
 {
-    std::unique_lock <std::mutex> lck(mMtx);
-    mTaskQueue.push(task);
-    mCon.notify_one();
-}
+    int index;
+    if (tThreadPool == this)
+        index = tWorkerIndex;
+    else
+        index = mNextWorker.fetch_add(1, std::memory_order_relaxed) % mWorkerNum;
 
-void ThreadPool::loop(){
+    {
+        std::lock_guard <std::mutex> lck(mWorkers[index].mMtx);
+        mWorkers[index].mTasks.push_back(task);
+    }
 
-    while(!mQuit){
+    // 先增加任务数再检查休眠线程数，与loop()中的顺序相反，保证不会漏掉唤醒
+    mPendingTasks.fetch_add(1, std::memory_order_seq_cst);
+    if (mIdleThreads.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard <std::mutex> lck(mMtx);
+        mCon.notify_one();
+    }
+}
 
-        std::unique_lock <std::mutex> lck(mMtx);
-        if (mTaskQueue.empty()) {
-            mCon.wait(lck); 
+bool ThreadPool::popTask(int index, Task& task)
+{
+    {
+        Worker& worker = mWorkers[index];
+        std::lock_guard <std::mutex> lck(worker.mMtx);
+        if (!worker.mTasks.empty()) {
+            task = worker.mTasks.front();
+            worker.mTasks.pop_front();
+            return true;
         }
-     
+    }
 
-        if(mTaskQueue.empty())
-            continue;
+    for (int i = 1; i < mWorkerNum; ++i) {
+        Worker& victim = mWorkers[(index + i) % mWorkerNum];
+        std::lock_guard <std::mutex> lck(victim.mMtx);
+        if (!victim.mTasks.empty()) {
+            task = victim.mTasks.back();
+            victim.mTasks.pop_back();
+            return true;
+        }
+    }
 
-        Task task = mTaskQueue.front();
-        mTaskQueue.pop();
+    return false;
+}
+
+void ThreadPool::loop(int index){
+
+    tThreadPool = this;
+    tWorkerIndex = index;
+
+    while(!mQuit){
+
+        Task task;
+        if (popTask(index, task)) {
+            mPendingTasks.fetch_sub(1, std::memory_order_relaxed);
+            task.handle();// 不持有任何锁
+            continue;
+        }
 
-        task.handle();
+        std::unique_lock <std::mutex> lck(mMtx);
+        mIdleThreads.fetch_add(1, std::memory_order_seq_cst);
+        while (!mQuit && mPendingTasks.load(std::memory_order_seq_cst) <= 0)
+            mCon.wait(lck);
+        mIdleThreads.fetch_sub(1, std::memory_order_relaxed);
     }
 
 }
@@ -48,16 +106,22 @@ void ThreadPool::loop(){
 void ThreadPool::createThreads()
 {
     std::unique_lock <std::mutex> lck(mMtx);
-    for(auto & mThread : mThreads)
-        mThread.start(this);
+    for (int i = 0; i < mWorkerNum; ++i) {
+        WorkerArg* arg = new WorkerArg;
+        arg->mThreadPool = this;
+        arg->mIndex = i;
+        mThreads[i].start(arg);
+    }
 }
 
 void ThreadPool::cancelThreads()
 {
-    std::unique_lock <std::mutex> lck(mMtx);
-    mQuit = true;
-    // 唤醒所有等待的线程，使它们能够检查退出条件
-    mCon.notify_all();
+    {
+        std::unique_lock <std::mutex> lck(mMtx);
+        mQuit = true;
+        // 唤醒所有等待的线程，使它们能够检查退出条件
+        mCon.notify_all();
+    }
     for(auto & mThread : mThreads)
         // 等待每个线程完成其执行并安全退出
         mThread.join();
@@ -67,6 +131,10 @@ void ThreadPool::cancelThreads()
 
 void ThreadPool::MThread::run(void* arg)
 {
-    ThreadPool* threadPool = (ThreadPool*)arg;
-    threadPool->loop();
+    WorkerArg* workerArg = (WorkerArg*)arg;
+    ThreadPool* threadPool = workerArg->mThreadPool;
+    int index = workerArg->mIndex;
+    delete workerArg;
+
+    threadPool->loop(index);
 }
\ No newline at end of file
@@ -1,12 +1,18 @@
 ﻿#ifndef ZYX_RTSPSERVER_THREADPOOL_H
 #define ZYX_RTSPSERVER_THREADPOOL_H
-#include <queue>
+#include <deque>
 #include <vector>
+#include <atomic>
 
 #include "Thread.h"
 #include <mutex> 
 #include <condition_variable>
 
+/*
+    工作窃取线程池：每个工作线程有自己的任务双端队列，自己从队头取（先进先出，重新投递的任务排在已有任务之后），
+    本线程没有任务时从其他线程的队尾窃取；任务执行时不持有任何锁，N个线程可同时执行N个任务。
+    需要串行执行的任务（如同一MediaSource的读取）使用Strand。
+*/
 class ThreadPool
 {
 public:
@@ -24,9 +30,10 @@ public:
                     mTaskCallback(mArg);
             }
 
-            bool operator=(const Task& task) {
+            Task& operator=(const Task& task) {
                 this->mTaskCallback = task.mTaskCallback;
                 this->mArg = task.mArg;
+                return *this;
             }
         private:
             TaskCallback mTaskCallback;
@@ -38,10 +45,11 @@ public:
     explicit ThreadPool(int num);
     ~ThreadPool();
 
-    void addTask(Task& task);
+    void addTask(Task& task);// 线程安全；在工作线程中调用时放入本线程的队列，否则轮流放入各线程的队列
 
 private:
-    void loop();
+    void loop(int index);
+    bool popTask(int index, Task& task);// 先取本线程队列，再窃取其他线程
 
     class MThread : public Thread
     {
@@ -50,15 +58,26 @@ private:
     };
     void createThreads();
     void cancelThreads();
-    
+
+    // 单个工作线程的任务队列，锁只在入队/出队时短暂持有
+    struct Worker
+    {
+        std::deque<Task> mTasks;
+        std::mutex mMtx;
+    };
 
 private:
-    std::queue<Task> mTaskQueue;
-    std::mutex mMtx; // 互斥锁.
+    int mWorkerNum;
+    Worker* mWorkers;
+    std::atomic<unsigned int> mNextWorker;// 非工作线程投递任务时轮流选择的队列
+    std::atomic<int> mPendingTasks;// 所有队列中的任务总数
+    std::atomic<int> mIdleThreads;// 正在等待的线程数，为0时投递任务不必唤醒
+
+    std::mutex mMtx; // 互斥锁，只用于线程休眠和唤醒.
     std::condition_variable mCon; // 条件变量.
 
     std::vector<MThread> mThreads;
-    bool mQuit;
+    std::atomic<bool> mQuit;
 };
 
 #endif //ZYX_RTSPSERVER_THREADPOOL_H
\ No newline at end of file
@@ -1,6 +1,7 @@
 ﻿#include "Timer.h"
 #ifndef WIN32
 #include <sys/timerfd.h>
+#include <unistd.h>
 #endif // !WIN32
 #include <time.h>
 #include <chrono>
@@ -23,15 +24,15 @@
 //    it_value和it_interval都为0 表示停止定时器
 
 
-static bool timerFdSetTime(int fd, Timer::Timestamp when, Timer::TimeInterval period) {
+static bool timerFdSetTime(int fd, Timer::TimestampNs when, Timer::TimeIntervalNs period) {
 
 #ifndef WIN32
     struct itimerspec newVal;
 
-    newVal.it_value.tv_sec = when / 1000; //ms->s
-    newVal.it_value.tv_nsec = when % 1000 * 1000 * 1000; //ms->ns
-    newVal.it_interval.tv_sec = period / 1000;
-    newVal.it_interval.tv_nsec = period % 1000 * 1000 * 1000;
+    newVal.it_value.tv_sec = when / 1000000000; //ns->s
+    newVal.it_value.tv_nsec = when % 1000000000;
+    newVal.it_interval.tv_sec = period / 1000000000;
+    newVal.it_interval.tv_nsec = period % 1000000000;
 
     int oldValue = timerfd_settime(fd, TFD_TIMER_ABSTIME, &newVal, NULL);
     if (oldValue < 0) {
@@ -44,7 +45,8 @@ static bool timerFdSetTime(int fd, Timer::Timestamp when, Timer::TimeInterval pe
 }
 
 
-Timer::Timer(TimerEvent* event, Timestamp timestamp, TimeInterval timeInterval, TimerId timerId) :
+Timer::Timer(TimerEvent* event, TimestampNs timestamp, TimeIntervalNs timeInterval, TimerId timerId) :
+        TimerNode(),
         mTimerEvent(event),
         mTimestamp(timestamp),
         mTimeInterval(timeInterval),
@@ -72,6 +74,18 @@ Timer::Timestamp Timer::getCurTime(){
     return now / 1000000;
 #endif // !WIN32
 
+}
+// 获取系统从启动到目前的纳秒数
+Timer::TimestampNs Timer::getCurTimeNs(){
+#ifndef WIN32
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((TimestampNs)now.tv_sec * 1000000000 + now.tv_nsec);
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif // !WIN32
+
 }
 Timer::Timestamp Timer::getCurTimestamp() {
     return std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -98,6 +112,10 @@ TimerManager* TimerManager::createNew(EventScheduler* scheduler){
 // 定时器
 TimerManager::TimerManager(EventScheduler* scheduler) :
         mPoller(scheduler->poller()),
+        mCurTick(Timer::getCurTimeNs() / TICK_NS),
+        mArmedTime(-1),
+        mRunningTimer(NULL),
+        mRunningTimerRemoved(false),
         mLastTimerId(0){
 
 #ifndef WIN32
@@ -127,46 +145,179 @@ TimerManager::~TimerManager()
 #ifndef WIN32
     mPoller->removeIOEvent(mTimerIOEvent);
     delete mTimerIOEvent;
+    ::close(mTimerFd);
 #endif // !WIN32
 
+    for (std::unordered_map<Timer::TimerId, Timer*>::iterator it = mTimers.begin(); it != mTimers.end(); ++it)
+        delete it->second;
 }
 //addTimer 方法的作用是将新的定时事件添加到定时器管理器中，并设置其首次执行时间和重复间隔。这使得事件调度能够在指定的时间间隔内定期触发。 
-Timer::TimerId TimerManager::addTimer(TimerEvent* event, Timer::Timestamp timestamp,
-                                      Timer::TimeInterval timeInterval)
+Timer::TimerId TimerManager::addTimer(TimerEvent* event, Timer::TimestampNs timestamp,
+                                      Timer::TimeIntervalNs timeInterval)
 {
-    ++mLastTimerId;
-    Timer timer(event, timestamp, timeInterval,mLastTimerId);
+    // 没有任何定时器时时间轮不会推进，先对齐到当前时间，避免下次处理时逐刻度追赶
+    if (mTimers.empty())
+        mCurTick = Timer::getCurTimeNs() / TICK_NS;
 
+    ++mLastTimerId;
+    Timer* timer = new Timer(event, timestamp, timeInterval, mLastTimerId);
 
     mTimers.insert(std::make_pair(mLastTimerId, timer));
-    //mEvents.insert(std::make_pair(TimerIndex(timestamp, mLastTimerId), timer));
-    mEvents.insert(std::make_pair(timestamp, timer));
-    modifyTimeout();
+    addToWheel(timer);
+
+    // 只有新定时器早于timerfd当前设置的时间时才需要重设
+    if (mArmedTime < 0 || timestamp < mArmedTime)
+        modifyTimeout();
 
     return mLastTimerId;
 }
 
 bool TimerManager::removeTimer(Timer::TimerId timerId)
 {
-    std::map<Timer::TimerId, Timer>::iterator it = mTimers.find(timerId);
-    if(it != mTimers.end())
-    {
-        mTimers.erase(timerId);
-        // TODO 还需要删除mEvents的事件
+    std::unordered_map<Timer::TimerId, Timer*>::iterator it = mTimers.find(timerId);
+    if (it == mTimers.end())
+        return false;
+
+    Timer* timer = it->second;
+    if (timer == mRunningTimer) {
+        // 在自身回调中删除，回调返回后再释放
+        mRunningTimerRemoved = true;
+        return true;
     }
 
-    modifyTimeout();
+    timer->unlink();
+    mTimers.erase(it);
+    delete timer;
 
+    // timerfd不必重设：到期后若没有需要处理的定时器，会重新计算下一次超时
     return true;
 }
 
+void TimerManager::addToWheel(Timer* timer)
+{
+    Timer::Timestamp expires = timer->mTimestamp / TICK_NS;
+    if (expires < mCurTick)
+        expires = mCurTick;// 已过期的定时器放在当前刻度，下次处理时执行
+
+    Timer::Timestamp idx = expires - mCurTick;
+    TimerNode* list = NULL;
+
+    if (idx < WHEEL_ROOT_SIZE) {
+        list = &mRootWheel[expires & (WHEEL_ROOT_SIZE - 1)];
+    }
+    else {
+        for (int level = 0; level < WHEEL_LEVEL_NUM - 1; ++level) {
+            int shift = WHEEL_ROOT_BITS + level * WHEEL_BITS;
+            if (idx < ((Timer::Timestamp)1 << (shift + WHEEL_BITS))) {
+                list = &mWheels[level][(expires >> shift) & (WHEEL_SIZE - 1)];
+                break;
+            }
+        }
+
+        if (!list) {
+            // 超出时间轮范围，先放在最高层能表示的最远位置，下放时按真实超时时间重新计算
+            int shift = WHEEL_ROOT_BITS + (WHEEL_LEVEL_NUM - 2) * WHEEL_BITS;
+            expires = mCurTick + ((Timer::Timestamp)1 << (shift + WHEEL_BITS)) - 1;
+            list = &mWheels[WHEEL_LEVEL_NUM - 2][(expires >> shift) & (WHEEL_SIZE - 1)];
+        }
+    }
+
+    list->pushBack(timer);
+}
+
+// 把高层的一个槽位整体下放，按剩余时间重新放入低层
+void TimerManager::cascade(int level, int index)
+{
+    TimerNode list;
+    mWheels[level][index].moveTo(&list);
+
+    while (!list.empty()) {
+        Timer* timer = static_cast<Timer*>(list.mNext);
+        timer->unlink();
+        addToWheel(timer);
+    }
+}
+
+// 执行第0层index槽位中已到期的定时器，未到期的（当前刻度内更晚的时间）留在槽位中
+void TimerManager::expire(int index, Timer::TimestampNs now)
+{
+    TimerNode list;
+    mRootWheel[index].moveTo(&list);
+
+    // 每次从链表头取出一个再执行，回调中删除同一槽位的其他定时器也是安全的
+    while (!list.empty()) {
+        Timer* timer = static_cast<Timer*>(list.mNext);
+        timer->unlink();
+
+        if (timer->mTimestamp > now) {
+            mRootWheel[index].pushBack(timer);
+            continue;
+        }
+
+        mRunningTimer = timer;
+        mRunningTimerRemoved = false;
+        bool timerEventIsStop = timer->handleEvent();
+        mRunningTimer = NULL;
+
+        if (timer->mRepeat && !timerEventIsStop && !mRunningTimerRemoved) {
+            timer->mTimestamp = Timer::getCurTimeNs() + timer->mTimeInterval;
+            addToWheel(timer);
+        }
+        else {
+            mTimers.erase(timer->mTimerId);
+            delete timer;
+        }
+    }
+}
+
+Timer::TimestampNs TimerManager::nextTimeout()
+{
+    if (mTimers.empty())
+        return -1;
+
+    Timer::TimestampNs timeout = -1;
+
+    // 第0层：从当前刻度开始第一个非空槽位中最早的定时器
+    for (int i = 0; i < WHEEL_ROOT_SIZE; ++i) {
+        TimerNode* list = &mRootWheel[(mCurTick + i) & (WHEEL_ROOT_SIZE - 1)];
+        if (list->empty())
+            continue;
+
+        for (TimerNode* node = list->mNext; node != list; node = node->mNext) {
+            Timer::TimestampNs timestamp = static_cast<Timer*>(node)->mTimestamp;
+            if (timeout < 0 || timestamp < timeout)
+                timeout = timestamp;
+        }
+        break;
+    }
+
+    // 高层：下一个非空槽位被下放的刻度
+    for (int level = 0; level < WHEEL_LEVEL_NUM - 1; ++level) {
+        int shift = WHEEL_ROOT_BITS + level * WHEEL_BITS;
+        Timer::Timestamp pos = mCurTick >> shift;
+        for (int k = 1; k <= WHEEL_SIZE; ++k) {
+            if (!mWheels[level][(pos + k) & (WHEEL_SIZE - 1)].empty()) {
+                Timer::TimestampNs cascadeTime = ((pos + k) << shift) * TICK_NS;
+                if (timeout < 0 || cascadeTime < timeout)
+                    timeout = cascadeTime;
+                break;
+            }
+        }
+    }
+
+    return timeout;
+}
+
 void TimerManager::modifyTimeout()
 {
 #ifndef WIN32
-    std::multimap<Timer::Timestamp, Timer>::iterator it = mEvents.begin();
-    if (it != mEvents.end()) {// 存在至少一个定时器
-        Timer timer = it->second;
-        timerFdSetTime(mTimerFd, timer.mTimestamp, timer.mTimeInterval);
+    Timer::TimestampNs timeout = nextTimeout();
+    if (timeout == mArmedTime)
+        return;
+
+    mArmedTime = timeout;
+    if (timeout >= 0) {// 存在至少一个定时器
+        timerFdSetTime(mTimerFd, timeout, 0);
     }
     else {
         timerFdSetTime(mTimerFd, 0, 0);
@@ -182,33 +333,36 @@ void TimerManager::readCallback(void *arg) {
 
 void TimerManager::handleRead() {
 
-    //LOGI("mTimers.size()=%d,mEvents.size()=%d",mTimers.size(),mEvents.size());
-    Timer::Timestamp timestamp = Timer::getCurTime();
-    if (!mTimers.empty() && !mEvents.empty()) {
-
-        std::multimap<Timer::Timestamp, Timer>::iterator it = mEvents.begin();
-        Timer timer = it->second;
-        int expire = timer.mTimestamp - timestamp;
-
-        //LOGI("timestamp=%d,mTimestamp=%d,expire=%d,timeInterval=%d", timestamp, timer.mTimestamp, expire, timer.mTimeInterval);
-
-        if (timestamp > timer.mTimestamp || expire == 0) {
+#ifndef WIN32
+    uint64_t expirations;
+    ssize_t ret = ::read(mTimerFd, &expirations, sizeof(expirations));// 清除timerfd的可读状态
+    (void)ret;
+    mArmedTime = -1;// 已到期，需要重新设置
+#endif // !WIN32
 
-            bool timerEventIsStop = timer.handleEvent();
-            mEvents.erase(it);
-            if (timer.mRepeat) {
-                if (timerEventIsStop) {
-                    mTimers.erase(timer.mTimerId);
-                }else {
-                    timer.mTimestamp = timestamp + timer.mTimeInterval;
-                    mEvents.insert(std::make_pair(timer.mTimestamp, timer));
-                }
+    Timer::TimestampNs now = Timer::getCurTimeNs();
+    Timer::Timestamp nowTick = now / TICK_NS;
+    if (mTimers.empty())
+        mCurTick = nowTick;
+
+    // 先处理当前刻度中剩余的定时器，再逐刻度推进，每转完一圈把上一层对应的槽位下放
+    expire(mCurTick & (WHEEL_ROOT_SIZE - 1), now);
+    while (mCurTick < nowTick) {
+        ++mCurTick;
+
+        int index = mCurTick & (WHEEL_ROOT_SIZE - 1);
+        if (index == 0) {
+            for (int level = 0; level < WHEEL_LEVEL_NUM - 1; ++level) {
+                int i = (mCurTick >> (WHEEL_ROOT_BITS + level * WHEEL_BITS)) & (WHEEL_SIZE - 1);
+                cascade(level, i);
+                if (i != 0)
+                    break;
             }
-            else {
-                mTimers.erase(timer.mTimerId);
-            }
-
         }
+
+        if (!mRootWheel[index].empty())
+            expire(index, now);
     }
+
     modifyTimeout();
 }
@@ -1,6 +1,6 @@
 ﻿#ifndef ZYX_RTSPSERVER_TIMER_H
 #define ZYX_RTSPSERVER_TIMER_H
-#include <map>
+#include <unordered_map>
 #include <stdint.h>
 
 class EventScheduler;
@@ -8,33 +8,76 @@ class Poller;
 class TimerEvent;
 class IOEvent;
 
-class Timer
+// 时间轮槽位中的双向循环链表节点，槽位本身是哨兵节点
+class TimerNode
+{
+public:
+    TimerNode() : mPrev(this), mNext(this) {}
+
+    bool empty() const { return mNext == this; }
+    void unlink() {
+        mPrev->mNext = mNext;
+        mNext->mPrev = mPrev;
+        mPrev = mNext = this;
+    }
+    void pushBack(TimerNode* node) {
+        node->mPrev = mPrev;
+        node->mNext = this;
+        mPrev->mNext = node;
+        mPrev = node;
+    }
+    // 把本链表中的所有节点整体移动到list（list须为空）
+    void moveTo(TimerNode* list) {
+        if (empty())
+            return;
+        list->mNext = mNext;
+        list->mPrev = mPrev;
+        mNext->mPrev = list;
+        mPrev->mNext = list;
+        mPrev = mNext = this;
+    }
+
+    TimerNode* mPrev;
+    TimerNode* mNext;
+};
+
+class Timer : public TimerNode
 {
 public:
     typedef uint32_t TimerId;
     typedef int64_t Timestamp; //ms
     typedef uint32_t TimeInterval; //ms
+    typedef int64_t TimestampNs; //ns
+    typedef int64_t TimeIntervalNs; //ns
 
     ~Timer();
 
     static Timestamp getCurTime();// 获取当前系统启动以来的毫秒数
+    static TimestampNs getCurTimeNs();// 获取当前系统启动以来的纳秒数
     static Timestamp getCurTimestamp();// 获取毫秒级时间戳（13位）
 
 private:
     friend class TimerManager;
-    Timer(TimerEvent* event, Timestamp timestamp, TimeInterval timeInterval, TimerId timerId);
+    Timer(TimerEvent* event, TimestampNs timestamp, TimeIntervalNs timeInterval, TimerId timerId);
 
 private:
     bool handleEvent();
 private:
     TimerEvent* mTimerEvent;
-    Timestamp mTimestamp;
-    TimeInterval mTimeInterval;
+    TimestampNs mTimestamp;
+    TimeIntervalNs mTimeInterval;
     TimerId mTimerId;
 
     bool mRepeat;
 };
 
+/*
+    分层时间轮：刻度为1ms，第0层256个槽，第1~3层各64个槽，可表示约18.6小时内的超时；
+    更远的定时器先放在最高层末尾，到期时重新计算位置。
+    插入、删除均为O(1)，高层槽位在低层转完一圈时整体下放到低层。
+    定时器本身按纳秒记录超时时间，刻度只用于分槽；当前刻度内未到期的定时器留在槽中，
+    timerfd按纳秒设置为下一个定时器的精确超时时间（或下一次需要下放的刻度），不会每次添加都重设。
+*/
 class TimerManager
 {
 public:
@@ -43,8 +86,8 @@ public:
     TimerManager(EventScheduler* scheduler);
     ~TimerManager();
 
-    Timer::TimerId addTimer(TimerEvent* event, Timer::Timestamp timestamp,
-                            Timer::TimeInterval timeInterval);
+    Timer::TimerId addTimer(TimerEvent* event, Timer::TimestampNs timestamp,
+                            Timer::TimeIntervalNs timeInterval);
     bool removeTimer(Timer::TimerId timerId);
 
 private:
@@ -52,11 +95,30 @@ private:
     void handleRead();
     void modifyTimeout();
 
+    void addToWheel(Timer* timer);
+    void cascade(int level, int index);
+    void expire(int index, Timer::TimestampNs now);
+    Timer::TimestampNs nextTimeout();// 下一次需要处理的时间，没有定时器时返回-1
 
 private:
+    enum
+    {
+        WHEEL_ROOT_BITS = 8,
+        WHEEL_BITS = 6,
+        WHEEL_ROOT_SIZE = 1 << WHEEL_ROOT_BITS,
+        WHEEL_SIZE = 1 << WHEEL_BITS,
+        WHEEL_LEVEL_NUM = 4,
+        TICK_NS = 1000000,// 刻度：1ms
+    };
+
     Poller* mPoller;
-    std::map<Timer::TimerId, Timer> mTimers;
-    std::multimap<Timer::Timestamp, Timer> mEvents;
+    std::unordered_map<Timer::TimerId, Timer*> mTimers;
+    TimerNode mRootWheel[WHEEL_ROOT_SIZE];
+    TimerNode mWheels[WHEEL_LEVEL_NUM - 1][WHEEL_SIZE];
+    Timer::Timestamp mCurTick;// 当前刻度，之前的刻度均已处理完
+    Timer::TimestampNs mArmedTime;// timerfd当前设置的时间，-1表示未设置
+    Timer* mRunningTimer;// 正在执行回调的定时器
+    bool mRunningTimerRemoved;// 正在执行的定时器在回调中被删除
     uint32_t mLastTimerId;
 #ifndef WIN32
     int mTimerFd;
@@ -0,0 +1,260 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+#include "../Live/AnnexB.h"
+
+/*
+    AnnexB起始码查找的测试和性能对比：
+    保留原H264FileMediaSource中逐字节的起始码查找作为参考实现，
+    scalar/sse2/avx2各实现在穷举的短数据、各对齐边界上的起始码和随机数据上的结果必须与其完全相同。
+    最后在一段多MB的模拟H.264码流上比较参考实现和各实现遍历所有nalu的耗时。
+    用法：AnnexBTest [码流大小MB，默认32]
+*/
+
+// 以下三个函数是原H264FileMediaSource中的实现
+static inline int startCode3(const uint8_t* buf)
+{
+    if (buf[0] == 0 && buf[1] == 0 && buf[2] == 1)
+        return 1;
+    else
+        return 0;
+}
+
+static inline int startCode4(const uint8_t* buf)
+{
+    if (buf[0] == 0 && buf[1] == 0 && buf[2] == 0 && buf[3] == 1)
+        return 1;
+    else
+        return 0;
+}
+
+static const uint8_t* findNextStartCode(const uint8_t* buf, int64_t len)
+{
+    int64_t i;
+
+    if (len < 3)
+        return NULL;
+
+    for (i = 0; i < len - 3; ++i)
+    {
+        if (startCode3(buf) || startCode4(buf))
+            return buf;
+
+        ++buf;
+    }
+
+    if (startCode3(buf))
+        return buf;
+
+    return NULL;
+}
+
+// 逐字节去掉防竞争字节的参考实现
+static int removeEmulationPreventionRef(const uint8_t* src, int size, uint8_t* dst)
+{
+    int zeros = 0;
+    int len = 0;
+    for (int i = 0; i < size; ++i)
+    {
+        if (zeros >= 2 && src[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = (src[i] == 0) ? zeros + 1 : 0;
+        dst[len++] = src[i];
+    }
+    return len;
+}
+
+static const char* gScanners[] = { "scalar", "sse2", "avx2" };
+static int gFailed = 0;
+
+// 从buf的每个位置开始查找，结果都要与参考实现相同；再按buildIndex的方式依次遍历所有起始码
+static void checkBuffer(const uint8_t* buf, int size, int maxStart)
+{
+    const uint8_t* end = buf + size;
+    for (int off = 0; off <= size && off <= maxStart; ++off)
+    {
+        const uint8_t* expect = findNextStartCode(buf + off, size - off);
+        const uint8_t* got = annexb::findStartCode(buf + off, end);
+        if (got != expect) {
+            if (gFailed++ < 10)
+                printf("%s: size=%d,off=%d,expect=%ld,got=%ld\n", annexb::scannerName(), size, off,
+                       expect ? (long)(expect - buf) : -1L, got ? (long)(got - buf) : -1L);
+            return;
+        }
+    }
+
+    const uint8_t* expect = findNextStartCode(buf, size);
+    const uint8_t* got = annexb::findStartCode(buf, end);
+    while (expect && got == expect)
+    {
+        const uint8_t* nalu = expect + (startCode3(expect) ? 3 : 4);
+        expect = findNextStartCode(nalu, end - nalu);
+        got = annexb::findStartCode(nalu, end);
+    }
+    if (got != expect) {
+        if (gFailed++ < 10)
+            printf("%s: walk size=%d,expect=%ld,got=%ld\n", annexb::scannerName(), size,
+                   expect ? (long)(expect - buf) : -1L, got ? (long)(got - buf) : -1L);
+        return;
+    }
+
+    std::vector<uint8_t> out1(size + 1), out2(size + 1);
+    int len1 = removeEmulationPreventionRef(buf, size, out1.data());
+    int len2 = annexb::removeEmulationPrevention(buf, size, out2.data());
+    if (len1 != len2 || memcmp(out1.data(), out2.data(), len1) != 0) {
+        if (gFailed++ < 10)
+            printf("%s: removeEmulationPrevention size=%d,expect len=%d,got len=%d\n",
+                   annexb::scannerName(), size, len1, len2);
+    }
+}
+
+// 长度0~7的数据，每个字节取0/1/3/0xff，全部穷举
+static void testExhaustive()
+{
+    static const uint8_t symbols[] = { 0, 1, 3, 0xff };
+    for (int size = 0; size <= 7; ++size)
+    {
+        int total = 1 << (2 * size);
+        for (int n = 0; n < total; ++n)
+        {
+            // 每次单独分配，数据的末尾就是分配的末尾
+            std::vector<uint8_t> buf(size);
+            for (int i = 0; i < size; ++i)
+                buf[i] = symbols[(n >> (2 * i)) & 3];
+            checkBuffer(buf.data(), size, size);
+        }
+    }
+}
+
+// 在16/32字节边界附近的各个位置放一个3字节或4字节起始码，背景分别是0xff和0
+static void testBoundaries()
+{
+    for (int size = 3; size <= 100; ++size)
+    {
+        for (int pos = 0; pos + 3 <= size; ++pos)
+        {
+            for (int variant = 0; variant < 4; ++variant)
+            {
+                std::vector<uint8_t> buf(size, (variant & 1) ? 0 : 0xff);
+                int codeLen = (variant & 2) ? 4 : 3;
+                if (pos + codeLen > size)
+                    continue;
+                memset(&buf[pos], 0, codeLen - 1);
+                buf[pos + codeLen - 1] = 1;
+                checkBuffer(buf.data(), size, pos + 1);// 从起始码之前和起始码内部开始
+            }
+        }
+    }
+}
+
+// 随机数据：0/1/3出现的概率很高，另外随机错开数据的起始对齐
+static void testRandom(int count)
+{
+    std::vector<uint8_t> mem(512 + 64);
+    for (int n = 0; n < count; ++n)
+    {
+        int size = rand() % 512;
+        uint8_t* buf = mem.data() + rand() % 64;
+        for (int i = 0; i < size; ++i)
+        {
+            int r = rand() % 8;
+            buf[i] = r < 4 ? 0 : (r < 6 ? 1 : (r < 7 ? 3 : (uint8_t)rand()));
+        }
+        checkBuffer(buf, size, 40);
+    }
+}
+
+// 模拟H.264码流：随机长度的nalu，起始码3字节和4字节混合，nalu内容随机
+static void buildStream(std::vector<uint8_t>& stream, size_t size)
+{
+    stream.resize(size);
+    size_t pos = 0;
+    while (pos < size)
+    {
+        size_t naluLen = 100 + rand() % 20000;
+        size_t codeLen = (rand() % 2) ? 4 : 3;
+        for (size_t i = 0; i < codeLen && pos < size; ++i, ++pos)
+            stream[pos] = (i + 1 == codeLen) ? 1 : 0;
+        for (size_t i = 0; i < naluLen && pos < size; ++i, ++pos)
+        {
+            uint8_t b = (uint8_t)rand();
+            stream[pos] = (b < 3) ? 0x80 : b;// 不在nalu中间产生起始码
+        }
+    }
+}
+
+static double now()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void benchmark(size_t mb)
+{
+    std::vector<uint8_t> stream;
+    buildStream(stream, mb * 1024 * 1024);
+    const uint8_t* data = stream.data();
+    const uint8_t* end = data + stream.size();
+
+    double start = now();
+    int refCount = 0;
+    const uint8_t* cur = findNextStartCode(data, end - data);
+    while (cur)
+    {
+        ++refCount;
+        const uint8_t* nalu = cur + (startCode3(cur) ? 3 : 4);
+        cur = findNextStartCode(nalu, end - nalu);
+    }
+    double refMs = now() - start;
+    printf("bench: %dMB,nalus=%d,old scanner %.1fms\n", (int)mb, refCount, refMs);
+
+    for (size_t i = 0; i < sizeof(gScanners) / sizeof(gScanners[0]); ++i)
+    {
+        if (!annexb::useScanner(gScanners[i]))
+            continue;
+
+        start = now();
+        int count = 0;
+        cur = annexb::findStartCode(data, end);
+        while (cur)
+        {
+            ++count;
+            const uint8_t* nalu = cur + ((cur[2] == 1) ? 3 : 4);
+            cur = annexb::findStartCode(nalu, end);
+        }
+        double ms = now() - start;
+        printf("bench: %s %.1fms (%.1fx)%s\n", gScanners[i], ms, ms > 0 ? refMs / ms : 0.0,
+               count == refCount ? "" : " nalus mismatch");
+        if (count != refCount)
+            ++gFailed;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t mb = argc > 1 ? (size_t)atoi(argv[1]) : 32;
+    srand(12345);
+
+    for (size_t i = 0; i < sizeof(gScanners) / sizeof(gScanners[0]); ++i)
+    {
+        if (!annexb::useScanner(gScanners[i])) {
+            printf("%s: not supported by this cpu, skipped\n", gScanners[i]);
+            continue;
+        }
+
+        int failed = gFailed;
+        testExhaustive();
+        testBoundaries();
+        testRandom(20000);
+        printf("%s: %s\n", gScanners[i], gFailed == failed ? "ok" : "FAILED");
+    }
+
+    if (mb > 0)
+        benchmark(mb);
+
+    return gFailed == 0 ? 0 : 1;
+}
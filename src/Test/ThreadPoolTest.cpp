@@ -0,0 +1,135 @@
+﻿#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include "../Scheduler/ThreadPool.h"
+#include "../Scheduler/Strand.h"
+
+/*
+    ThreadPool与Strand的测试：
+    1. 公平性：只有一个工作线程时，不断重新投递自己的繁忙Strand不能饿死同一线程队列中的其他任务
+    2. 串行性：多个线程同时post()同一个Strand，回调不会并发执行，也不会无限叠加
+*/
+
+#define BUSY_RUNS 1000
+#define OTHER_TASK_NUM 10
+
+static ThreadPool* gThreadPool = NULL;
+static Strand* gBusyStrand = NULL;
+static std::atomic<int> gBusyRuns(0);
+static std::atomic<int> gOtherDone(0);
+static std::atomic<int> gMaxRunsSeen(0);// 其他任务执行时繁忙Strand已执行的次数
+static ThreadPool::Task gOtherTasks[OTHER_TASK_NUM];
+
+static void spin(int us)
+{
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+    while (std::chrono::steady_clock::now() < end) {}
+}
+
+static void otherTaskCallback(void* arg)
+{
+    int runs = gBusyRuns.load();
+    int seen = gMaxRunsSeen.load();
+    while (runs > seen && !gMaxRunsSeen.compare_exchange_weak(seen, runs)) {}
+    ++gOtherDone;
+}
+
+static void busyStrandCallback(void* arg)
+{
+    int runs = ++gBusyRuns;
+    spin(20);
+
+    // 第一次执行时在本工作线程中投递其他任务，与Strand的重新投递进入同一个队列
+    if (runs == 1) {
+        for (int i = 0; i < OTHER_TASK_NUM; ++i) {
+            gOtherTasks[i].setTaskCallback(otherTaskCallback, NULL);
+            gThreadPool->addTask(gOtherTasks[i]);
+        }
+    }
+
+    if (runs < BUSY_RUNS)
+        gBusyStrand->post();
+}
+
+static bool waitFor(std::atomic<int>& value, int target)
+{
+    for (int i = 0; i < 5000; ++i) {
+        if (value.load() >= target)
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+static bool testFairness()
+{
+    gThreadPool = ThreadPool::createNew(1);
+    gBusyStrand = new Strand(gThreadPool, busyStrandCallback, NULL);
+
+    gBusyStrand->post();
+    bool finished = waitFor(gBusyRuns, BUSY_RUNS) && waitFor(gOtherDone, OTHER_TASK_NUM);
+
+    delete gThreadPool;
+    delete gBusyStrand;
+
+    // 其他任务应在繁忙Strand的下一次执行之前完成，而不是等它执行完所有轮次
+    bool ok = finished && gMaxRunsSeen.load() < BUSY_RUNS / 2;
+    printf("fairness: busy runs=%d,other done=%d,busy runs seen by other tasks=%d %s\n",
+           gBusyRuns.load(), gOtherDone.load(), gMaxRunsSeen.load(), ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static std::atomic<int> gRunning(0);
+static std::atomic<int> gSerialRuns(0);
+static std::atomic<bool> gOverlapped(false);
+
+static void serialStrandCallback(void* arg)
+{
+    if (gRunning.fetch_add(1) != 0)
+        gOverlapped = true;
+    spin(5);
+    ++gSerialRuns;
+    gRunning.fetch_sub(1);
+}
+
+static bool testSerial()
+{
+    const int postThreadNum = 4;
+    const int postNum = 5000;
+    ThreadPool* threadPool = ThreadPool::createNew(4);
+    Strand* strand = new Strand(threadPool, serialStrandCallback, NULL);
+
+    std::thread threads[postThreadNum];
+    for (int i = 0; i < postThreadNum; ++i) {
+        threads[i] = std::thread([strand, postNum]() {
+            for (int k = 0; k < postNum; ++k) {
+                strand->post();
+                spin(1);// 让post()与回调的执行交错
+            }
+        });
+    }
+    for (int i = 0; i < postThreadNum; ++i)
+        threads[i].join();
+
+    // 最后一次post()之后至少还会执行一次
+    int runs = gSerialRuns.load();
+    strand->post();
+    bool finished = waitFor(gSerialRuns, runs + 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    delete threadPool;
+    delete strand;
+
+    bool ok = finished && !gOverlapped && gSerialRuns.load() > 1 && gSerialRuns.load() <= postThreadNum * postNum + 1;
+    printf("serial: posts=%d,runs=%d,overlapped=%d %s\n",
+           postThreadNum * postNum + 1, gSerialRuns.load(), (int)gOverlapped.load(), ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main()
+{
+    bool ok = testFairness();
+    ok = testSerial() && ok;
+    return ok ? 0 : 1;
+}
@@ -3,12 +3,9 @@
 #include "Scheduler/UsageEnvironment.h"
 #include "Live/MediaSessionManager.h"
 #include "Live/RtspServer.h"
-#include "Live/H264FileMediaSource.h"
-#include "Live/H264FileSink.h"
-#include "Live/AACFileMediaSource.h"
-
-#include "Live/AACFileSink.h"
+#include "Live/MediaRegistry.h"
 #include "Base/Log.h"
+#include <signal.h>
 
 // 函数指针 https://blog.csdn.net/m0_45388819/article/details/113822935
 
@@ -27,6 +24,10 @@ int main() {
 
     srand(time(NULL));//时间初始化
 
+#ifndef WIN32
+    signal(SIGPIPE, SIG_IGN);// 对端已关闭时继续写入不终止进程，由write返回错误
+#endif // !WIN32
+
     // 通过定时器不断向客户端发送流信息
 
 
@@ -34,11 +35,17 @@ int main() {
     // 设置setTimerManagerReadCallback可读回调函数， 等待env->scheduler()->loop();触发readCallback回调函数
     // 进而继续：等待H264_Sink和AAC_Sink中的mTimeoutCallback设置好cbTimeout回调函数之后
     // 判断mTimeoutCallback来决定是否调用cbTimeout定时回调函数（不断发送AAC和H264的RTP数据包）
+    // Linux下使用epoll，不受FD_SETSIZE(1024)限制，每轮只处理活跃的描述符
+#ifndef WIN32
+    EventScheduler* scheduler = EventScheduler::createNew(EventScheduler::POLLER_EPOLL);
+#else
     EventScheduler* scheduler = EventScheduler::createNew(EventScheduler::POLLER_SELECT);
+#endif // !WIN32
 
     // 判断触发线程池mTaskCallback回调函数
     // 线程池主要判断是否触发：读取并解析aac和h264文件的任务队列的回调函数（数据来源处理）
-    ThreadPool* threadPool = ThreadPool::createNew(1);
+    // 工作窃取线程池，每个核一个线程；同一MediaSource的读取由其Strand串行执行
+    ThreadPool* threadPool = ThreadPool::createNew(std::thread::hardware_concurrency());
 
     // SessionManager容器用来管理Session。其中一个Session包含1个或多个流，track0，track1，...
     MediaSessionManager* sessMgr = MediaSessionManager::createNew();
@@ -58,39 +65,32 @@ int main() {
     */ 
     RtspServer* rtspServer = RtspServer::createNew(env, sessMgr,rtspAddr);
 
+    // 媒体注册表：按文件路径去重MediaSource和Sink
+    MediaRegistry* mediaRegistry = MediaRegistry::createNew(env);
+
     LOGI("----------session init start------");
     {   
         //创建一个session
         MediaSession* session = MediaSession::createNew("test");
 
         /*
-        设置taskCallback任务回调函数(解析H264裸流，将每一个NALU保存到mFrameInputQueue队列中， 并将处理过的NALU保存再mFrameOutputQueue) 
-        打开H264文件
-        往线程池任务队列添加任务
-        */
-        MediaSource* source = H264FileMediaSource::createNew(env, "../data/daliu.h264");
-
-        /* 
-        初始化H264_Sink, 创建TimerEvent，设置cbTimeout回调函数（发送RTP数据包）
-        调用runEvery 函数使得 让H264_Sink 类中的某个任务可以在指定的时间间隔内重复执行
+        通过媒体注册表按文件路径取得Sink，同一文件只会创建一份MediaSource和Sink：
+        H264FileMediaSource 设置taskCallback任务回调函数(在线程池中按访问单元读取H264裸流，填入帧环形队列的空闲槽位)
+        H264_Sink 创建TimerEvent，设置cbTimeout回调函数（发送RTP数据包）
+        多个session引用同一文件时共享读取、定时器和RTP封包
         */
-        Sink* sink = H264FileSink::createNew(env, source);
+        // 第二个参数：SPS、PPS等小nalu聚合为STAP-A包发送
+        Sink* sink = mediaRegistry->getSink("../data/daliu.h264", true);
 
         // 设置sendPacketCallback回调函数(选择使用TCP/UDP进行发送)
         session->addSink(MediaSession::TrackId0, sink);
 
         /*
-        设置taskCallback任务回调函数(解析AAC裸流)
-        打开AAC文件
-        往线程池任务队列添加任务
+        AACFileMediaSource 设置taskCallback任务回调函数(解析AAC裸流)
+        AAC_Sink 创建TimerEvent，设置cbTimeout回调函数（发送RTP数据包）
         */
-        source = AACFileMeidaSource::createNew(env, "../data/daliu.aac");
-
-        /*
-        初始化AAC_Sink, 创建TimerEvent，设置cbTimeout回调函数（发送RTP数据包）
-        调用runEvery 函数使得 让AAC_Sink 类中的某个任务可以在指定的时间间隔内重复执行
-        */
-        sink = AACFileSink::createNew(env, source);
+        // 多个AAC帧合成一个RTP包，音频包速率降为原来的几分之一，延时不超过AAC_AGGREGATE_MAX_DELAY_MS
+        sink = mediaRegistry->getSink("../data/daliu.aac", true);
 
         // 设置sendPacketCallback回调函数(选择使用TCP/UDP进行发送)
         session->addSink(MediaSession::TrackId1, sink);
@@ -102,8 +102,22 @@ int main() {
     }
     LOGI("----------session init end------");
 
+    // 多Reactor模式：每个CPU核一个工作循环，连接的RTSP交互与断开清理都在其所属的工作循环中完成
+    rtspServer->setWorkerNum(std::thread::hardware_concurrency());
+    // 各工作循环通过SO_REUSEPORT各自监听8554，大量客户端同时重连时由内核分散accept
+    rtspServer->setReusePort(true);
+    rtspServer->setBacklog(1024);
+    // RTP over UDP时用GSO发送大帧，内核不支持时自动回退为sendmmsg
+    rtspServer->setUdpGso(true);
+    // RTP over TCP发送队列超过高水位后丢帧：先丢非参考帧，再跳到下一个关键帧
+    rtspServer->setTcpHighWaterMark(2 * 1024 * 1024);
+
     // listen 并且 添加 mAcceptIOEvent 事件
-    rtspServer->start();
+    if (!rtspServer->start()) {
+        LOGE("rtsp server start failed");
+        delete rtspServer;
+        return -1;
+    }
 
     env->scheduler()->loop();
     return 0;